@@ -0,0 +1,94 @@
+/*
+ * Translated ROM code
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "aot.h"
+
+//Whether an image is loaded and mapped as ROM, so its code can't change
+static int image_matches(AOT *aot, const AOT_IMAGE *image){
+	unsigned int address;
+	unsigned int length;
+	uint8_t *page;
+
+	for(address = image->address; address < image->address + image->size; address += length){
+		page = aot->bus->read_pages[address>>8];
+		if(!page || is_ram_page(aot->bus, address>>8)){
+			return 0;
+		}
+		length = 0x100 - (address&0xFF);
+		if(address + length > image->address + image->size){
+			length = image->address + image->size - address;
+		}
+		if(memcmp(page + (address&0xFF), image->data + (address - image->address), length)){
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+AOT *aot_create(CPU_6502 *cpu, BUS *bus){
+	AOT *aot;
+
+	if(!aot_num_blocks){
+		return NULL;
+	}
+	aot = malloc(sizeof(AOT));
+	if(!aot){
+		return NULL;
+	}
+	aot->cpu = cpu;
+	aot->bus = bus;
+	aot_check(aot);
+
+	return aot;
+}
+
+void aot_free(AOT *aot){
+	free(aot);
+}
+
+unsigned int aot_check(AOT *aot){
+	unsigned int i;
+	unsigned int j;
+
+	memset(aot->entries, 0, sizeof(aot->entries));
+	aot->num_entries = 0;
+	for(i = 0; i < aot_num_images; i++){
+		if(!image_matches(aot, aot_images + i)){
+			continue;
+		}
+		for(j = 0; j < aot_num_blocks; j++){
+			if(aot_blocks[j].image == i){
+				aot->entries[aot_blocks[j].address] = aot_blocks + j;
+				aot->num_entries++;
+			}
+		}
+	}
+
+	return aot->num_entries;
+}
+
+unsigned long long int aot_run(AOT *aot, unsigned long long int cycle_budget){
+	CPU_6502 *cpu = aot->cpu;
+	unsigned long long int start_cycles;
+	unsigned long long int end_cycles;
+	const AOT_BLOCK *block;
+
+	start_cycles = cpu->cycles;
+	end_cycles = start_cycles + cycle_budget;
+	cpu->bus->event = 0;
+	do{
+		block = aot->entries[cpu->PC_reg];
+		//Close to the end of the slice, step instead so as not to run past it
+		if(block && cpu->cycles + block->max_cycles < end_cycles){
+			block->code(cpu);
+		} else {
+			execute_6502(cpu);
+		}
+	} while(cpu->cycles < end_cycles && !cpu->bus->event);
+
+	return cpu->cycles - start_cycles;
+}
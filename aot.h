@@ -0,0 +1,102 @@
+/*
+ * Translated ROM code
+ *
+ * aot_translate turns the code reachable in ROM images into C ahead of
+ * time, one function per basic block, and the functions are linked into
+ * the emulator. This runs ROM code at close to native speed on hosts
+ * that can't allow a JIT.
+ *
+ * Translations are only used where the ROM loaded at run time is mapped
+ * read-only and matches, byte for byte, the image translated. Everything
+ * else runs on the interpreter. A block keeps PC and cycles exact for
+ * every memory access, so devices see the same timing as they would
+ * under the interpreter.
+ */
+
+#ifndef AOT_H
+#define AOT_H
+
+#include <stdint.h>
+#include "cpu.h"
+#include "bus.h"
+
+typedef void (*AOT_BLOCK_CODE)(CPU_6502 *cpu);
+
+typedef struct AOT_IMAGE AOT_IMAGE;
+
+//A ROM image as it was translated
+struct AOT_IMAGE{
+	uint16_t address;
+	uint16_t size;
+	const uint8_t *data;
+};
+
+typedef struct AOT_BLOCK AOT_BLOCK;
+
+struct AOT_BLOCK{
+	uint16_t address;
+	//Index of the image the block was translated from
+	uint16_t image;
+	//Most cycles the block can take
+	uint16_t max_cycles;
+	AOT_BLOCK_CODE code;
+};
+
+//Generated by aot_translate, or empty when nothing was translated
+extern const AOT_IMAGE aot_images[];
+extern const unsigned int aot_num_images;
+extern const AOT_BLOCK aot_blocks[];
+extern const unsigned int aot_num_blocks;
+
+typedef struct AOT AOT;
+
+struct AOT{
+	CPU_6502 *cpu;
+	BUS *bus;
+	//Translated block starting at each address in a ROM that matches, or NULL
+	const AOT_BLOCK *entries[0x10000];
+	unsigned int num_entries;
+};
+
+//Returns NULL if nothing was translated
+AOT *aot_create(CPU_6502 *cpu, BUS *bus);
+
+void aot_free(AOT *aot);
+
+//Work out again which ROMs match, after the ROMs or their mapping changed
+//Returns the number of blocks that can be used
+unsigned int aot_check(AOT *aot);
+
+//Run translated blocks, and the interpreter everywhere else, like run_6502
+unsigned long long int aot_run(AOT *aot, unsigned long long int cycle_budget);
+
+/*
+ * Helpers for the generated code
+ *
+ * These do the same as the CPU core's own versions.
+ */
+
+static inline void aot_zero_negative(CPU_6502 *cpu, uint8_t value){
+	cpu->nz_result = value;
+}
+
+static inline void aot_compare(CPU_6502 *cpu, uint8_t reg, uint8_t value){
+	aot_zero_negative(cpu, reg - value);
+	cpu->P_reg = (cpu->P_reg&~(1<<CARRY)) | (reg >= value)<<CARRY;
+}
+
+static inline uint16_t aot_indexed(CPU_6502 *cpu, uint16_t address, uint8_t index){
+	cpu->crossed_page = ((address + index)&0xFF00) != (address&0xFF00);
+	return address + index;
+}
+
+static inline uint16_t aot_zero_page_word(CPU_6502 *cpu, uint8_t address){
+	return ((uint16_t) bus_read(cpu->bus, address)) | (((uint16_t) bus_read(cpu->bus, (uint8_t) (address + 1)))<<8);
+}
+
+//The 6502 doesn't carry into the high byte of the pointer when fetching it
+static inline uint16_t aot_indirect(CPU_6502 *cpu, uint16_t address){
+	return ((uint16_t) bus_read(cpu->bus, address)) | (((uint16_t) bus_read(cpu->bus, (address&0xFF00) | ((address + 1)&0xFF)))<<8);
+}
+
+#endif
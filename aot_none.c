@@ -0,0 +1,13 @@
+/*
+ * Translated ROM code when none was built
+ *
+ * Linked in place of the output of aot_translate. See "make aot".
+ */
+
+#include <stddef.h>
+#include "aot.h"
+
+const AOT_IMAGE aot_images[1] = {{0, 0, NULL}};
+const unsigned int aot_num_images = 0;
+const AOT_BLOCK aot_blocks[1] = {{0, 0, 0, NULL}};
+const unsigned int aot_num_blocks = 0;
@@ -0,0 +1,574 @@
+/*
+ * ROM translator
+ *
+ * Translates the code reachable in ROM images into C for aot.c to run:
+ *
+ *     aot_translate OUTPUT FILE:ADDRESS:SIZE...
+ *
+ * ADDRESS and SIZE are in hex, and the first SIZE bytes of FILE are taken
+ * as ROM at ADDRESS. Code is followed from the start of each image and
+ * from any of the 6502's vectors that lie in an image, through branches,
+ * jumps and subroutine calls. Each block found becomes a C function.
+ *
+ * Loads, stores, logic, compares, transfers, flag changes and branches
+ * are written out in C. Everything else calls the CPU core's own
+ * operation, so the translation can't drift from the interpreter.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <ctype.h>
+#include "cpu.h"
+#include "operations.h"
+
+#define MAX_IMAGES 16
+//Longest block before it is split, in instructions
+#define MAX_BLOCK_INSTRUCTIONS 64
+
+typedef struct OPERATION_NAME OPERATION_NAME;
+
+struct OPERATION_NAME{
+	void (*operation)(CPU_6502 *cpu, uint16_t address);
+	const char *name;
+};
+
+//Names of the operations, as the generated code calls them
+static const OPERATION_NAME operation_names[] = {
+	{adc, "adc"}, {and, "and"}, {asl_a, "asl_a"}, {asl, "asl"}, {bcc, "bcc"}, {bcs, "bcs"}, {beq, "beq"}, {bit, "bit"},
+	{bmi, "bmi"}, {bne, "bne"}, {bpl, "bpl"}, {brk, "brk"}, {bvc, "bvc"}, {bvs, "bvs"}, {clc, "clc"}, {cld, "cld"},
+	{cli, "cli"}, {clv, "clv"}, {cmp, "cmp"}, {cpx, "cpx"}, {cpy, "cpy"}, {dec, "dec"}, {dex, "dex"}, {dey, "dey"},
+	{eor, "eor"}, {inc, "inc"}, {inx, "inx"}, {iny, "iny"}, {jmp, "jmp"}, {jsr, "jsr"}, {lda, "lda"}, {ldx, "ldx"},
+	{ldy, "ldy"}, {lsr_a, "lsr_a"}, {lsr, "lsr"}, {nop, "nop"}, {ora, "ora"}, {pha, "pha"}, {php, "php"}, {pla, "pla"},
+	{plp, "plp"}, {rol_a, "rol_a"}, {rol, "rol"}, {ror_a, "ror_a"}, {ror, "ror"}, {rti, "rti"}, {rts, "rts"}, {sbc, "sbc"},
+	{sec, "sec"}, {sed, "sed"}, {sei, "sei"}, {sta, "sta"}, {stx, "stx"}, {sty, "sty"}, {tax, "tax"}, {tay, "tay"},
+	{tsx, "tsx"}, {txa, "txa"}, {txs, "txs"}, {tya, "tya"}
+};
+
+typedef struct IMAGE IMAGE;
+
+struct IMAGE{
+	char *file_name;
+	unsigned int address;
+	unsigned int size;
+};
+
+//Text of a function, built up before its declarations are known
+typedef struct TEXT TEXT;
+
+struct TEXT{
+	char *data;
+	size_t length;
+	size_t capacity;
+};
+
+static IMAGE images[MAX_IMAGES];
+static unsigned int num_images;
+static uint8_t memory[0x10000];
+//Index of the image holding each address, or -1
+static int image_at[0x10000];
+
+static unsigned char queued[0x10000];
+static uint16_t pending_blocks[0x10000];
+static unsigned int num_pending_blocks;
+
+static uint16_t block_addresses[0x10000];
+static uint16_t block_cycles[0x10000];
+static unsigned int num_blocks;
+
+static void append(TEXT *text, const char *format, ...){
+	va_list args;
+	int length;
+
+	va_start(args, format);
+	length = vsnprintf(NULL, 0, format, args);
+	va_end(args);
+	while(text->length + length + 1 > text->capacity){
+		text->capacity = text->capacity ? text->capacity*2 : 4096;
+		text->data = realloc(text->data, text->capacity);
+		if(!text->data){
+			fprintf(stderr, "Out of memory\n");
+			exit(1);
+		}
+	}
+	va_start(args, format);
+	vsnprintf(text->data + text->length, length + 1, format, args);
+	va_end(args);
+	text->length += length;
+}
+
+static const char *operation_name(const OPCODE *op){
+	unsigned int i;
+
+	for(i = 0; i < sizeof(operation_names)/sizeof(OPERATION_NAME); i++){
+		if(operation_names[i].operation == op->operation){
+			return operation_names[i].name;
+		}
+	}
+
+	return NULL;
+}
+
+static void queue_block(unsigned int address){
+	if(address <= 0xFFFF && image_at[address] >= 0 && !queued[address]){
+		queued[address] = 1;
+		pending_blocks[num_pending_blocks] = address;
+		num_pending_blocks++;
+	}
+}
+
+static int load_image(const char *argument){
+	IMAGE *image;
+	FILE *fp;
+	char *separator;
+	unsigned int i;
+
+	if(num_images == MAX_IMAGES){
+		fprintf(stderr, "Too many images\n");
+		return 0;
+	}
+	image = images + num_images;
+	image->file_name = malloc(strlen(argument) + 1);
+	strcpy(image->file_name, argument);
+	separator = strchr(image->file_name, ':');
+	if(!separator || sscanf(separator, ":%x:%x", &image->address, &image->size) != 2 || !image->size || image->address + image->size > 0x10000){
+		fprintf(stderr, "Expected FILE:ADDRESS:SIZE, not \"%s\"\n", argument);
+		return 0;
+	}
+	*separator = (char) 0;
+
+	fp = fopen(image->file_name, "rb");
+	if(!fp){
+		fprintf(stderr, "Could not open \"%s\"\n", image->file_name);
+		return 0;
+	}
+	if(fread(memory + image->address, 1, image->size, fp) != image->size){
+		fprintf(stderr, "\"%s\" is shorter than 0x%X bytes\n", image->file_name, image->size);
+		fclose(fp);
+		return 0;
+	}
+	fclose(fp);
+
+	for(i = image->address; i < image->address + image->size; i++){
+		if(image_at[i] >= 0){
+			fprintf(stderr, "\"%s\" overlaps another image\n", image->file_name);
+			return 0;
+		}
+		image_at[i] = num_images;
+	}
+	num_images++;
+
+	return 1;
+}
+
+//Print the instruction as an assembler would write it
+static void disassemble(TEXT *text, uint16_t pc, const OPCODE *op, const char *name){
+	char mnemonic[4];
+	unsigned int i;
+	uint16_t word;
+
+	for(i = 0; i < 3; i++){
+		mnemonic[i] = toupper(name[i]);
+	}
+	mnemonic[3] = (char) 0;
+	word = memory[(uint16_t) (pc + 1)] | memory[(uint16_t) (pc + 2)]<<8;
+
+	append(text, "\t//%04X  %s", pc, mnemonic);
+	switch(op->mode){
+		case IMPLIED:
+			if(strlen(name) > 3){
+				append(text, " A");
+			}
+			break;
+		case IMMEDIATE:
+			append(text, " #$%02X", word&0xFF);
+			break;
+		case ZERO_PAGE:
+			append(text, " $%02X", word&0xFF);
+			break;
+		case ZERO_PAGE_X:
+			append(text, " $%02X,X", word&0xFF);
+			break;
+		case ZERO_PAGE_Y:
+			append(text, " $%02X,Y", word&0xFF);
+			break;
+		case ABSOLUTE:
+			append(text, " $%04X", word);
+			break;
+		case ABSOLUTE_X:
+			append(text, " $%04X,X", word);
+			break;
+		case ABSOLUTE_Y:
+			append(text, " $%04X,Y", word);
+			break;
+		case INDIRECT:
+			append(text, " ($%04X)", word);
+			break;
+		case INDIRECT_X:
+			append(text, " ($%02X,X)", word&0xFF);
+			break;
+		case INDIRECT_Y:
+			append(text, " ($%02X),Y", word&0xFF);
+			break;
+		case RELATIVE:
+			append(text, " $%04X", (uint16_t) (pc + 2 + (int8_t) (word&0xFF)));
+			break;
+	}
+	append(text, "\n");
+}
+
+static char register_name(const char *name){
+	return toupper(name[strlen(name) - 1]);
+}
+
+//Condition under which a branch is taken
+static const char *branch_condition(const char *name){
+	static const char *conditions[][2] = {
+		{"bpl", "!negative_flag_6502(cpu)"},
+		{"bmi", "negative_flag_6502(cpu)"},
+		{"bvc", "!(cpu->P_reg&(1<<OVERFLOW))"},
+		{"bvs", "cpu->P_reg&(1<<OVERFLOW)"},
+		{"bcc", "!(cpu->P_reg&(1<<CARRY))"},
+		{"bcs", "cpu->P_reg&(1<<CARRY)"},
+		{"bne", "!zero_flag_6502(cpu)"},
+		{"beq", "zero_flag_6502(cpu)"}
+	};
+	unsigned int i;
+
+	for(i = 0; i < sizeof(conditions)/sizeof(conditions[0]); i++){
+		if(!strcmp(name, conditions[i][0])){
+			return conditions[i][1];
+		}
+	}
+
+	return NULL;
+}
+
+static int ends_block(const char *name){
+	return branch_condition(name) || !strcmp(name, "jmp") || !strcmp(name, "jsr") || !strcmp(name, "rts") || !strcmp(name, "rti") || !strcmp(name, "brk");
+}
+
+//Whether the instruction is written out in C, or left to the CPU core's operation
+static int is_inline(const char *name){
+	static const char *inline_names[] = {
+		"lda", "ldx", "ldy", "sta", "stx", "sty", "and", "ora", "eor", "cmp", "cpx", "cpy", "inc", "dec",
+		"inx", "iny", "dex", "dey", "tax", "tay", "txa", "tya", "tsx", "txs",
+		"clc", "sec", "cld", "sed", "cli", "sei", "clv", "nop", "jmp"
+	};
+	unsigned int i;
+
+	if(branch_condition(name)){
+		return 1;
+	}
+	for(i = 0; i < sizeof(inline_names)/sizeof(inline_names[0]); i++){
+		if(!strcmp(name, inline_names[i])){
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+//Write out the instruction at pc. Cycles of instructions that don't touch memory are saved up in pending_cycles.
+//Returns whether the instruction leaves PC pointing past itself.
+static int translate_instruction(TEXT *text, uint16_t pc, const OPCODE *op, const char *name, unsigned int *pending_cycles, unsigned char *uses_value, unsigned char last){
+	char address[96];
+	char value[128];
+	uint16_t next_pc;
+	uint16_t word;
+	uint16_t target;
+	unsigned char touches_memory;
+	char reg;
+
+	disassemble(text, pc, op, name);
+	next_pc = pc + mode_lengths[op->mode];
+	word = memory[(uint16_t) (pc + 1)] | memory[(uint16_t) (pc + 2)]<<8;
+
+	//Branches leave the block either way
+	if(branch_condition(name)){
+		target = next_pc + (int8_t) (word&0xFF);
+		append(text, "\tcpu->cycles += %u;\n", *pending_cycles + op->cycles);
+		*pending_cycles = 0;
+		append(text, "\tcpu->PC_reg = 0x%04X;\n", next_pc);
+		append(text, "\tif(%s){\n", branch_condition(name));
+		append(text, "\t\tcpu->cycles += %u;\n", (target&0xFF00) != (next_pc&0xFF00) ? 2 : 1);
+		append(text, "\t\tcpu->PC_reg = 0x%04X;\n", target);
+		append(text, "\t}\n");
+		return 0;
+	}
+
+	switch(op->mode){
+		case IMPLIED:
+			touches_memory = 0;
+			sprintf(address, "0");
+			break;
+		case IMMEDIATE:
+		case RELATIVE:
+			touches_memory = 0;
+			sprintf(address, "0x%04X", op->mode == IMMEDIATE ? (uint16_t) (pc + 1) : (uint16_t) (next_pc + (int8_t) (word&0xFF)));
+			break;
+		case ZERO_PAGE:
+			touches_memory = 1;
+			sprintf(address, "0x%02X", word&0xFF);
+			break;
+		case ABSOLUTE:
+			//Jumping doesn't read the target
+			touches_memory = strcmp(name, "jmp");
+			sprintf(address, "0x%04X", word);
+			break;
+		default:
+			touches_memory = 1;
+			sprintf(address, "address");
+			break;
+	}
+	if(!is_inline(name)){
+		touches_memory = 1;
+	}
+
+	if(touches_memory){
+		if(*pending_cycles){
+			append(text, "\tcpu->cycles += %u;\n", *pending_cycles);
+			*pending_cycles = 0;
+		}
+		//While the address is worked out PC still points at the instruction, as in the interpreter
+		if(op->mode == INDIRECT || op->mode == INDIRECT_X || op->mode == INDIRECT_Y){
+			append(text, "\tcpu->PC_reg = 0x%04X;\n", pc);
+		}
+		switch(op->mode){
+			case ZERO_PAGE_X:
+				append(text, "\taddress = (uint8_t) (0x%02X + cpu->X_reg);\n", word&0xFF);
+				break;
+			case ZERO_PAGE_Y:
+				append(text, "\taddress = (uint8_t) (0x%02X + cpu->Y_reg);\n", word&0xFF);
+				break;
+			case ABSOLUTE_X:
+				append(text, "\taddress = aot_indexed(cpu, 0x%04X, cpu->X_reg);\n", word);
+				break;
+			case ABSOLUTE_Y:
+				append(text, "\taddress = aot_indexed(cpu, 0x%04X, cpu->Y_reg);\n", word);
+				break;
+			case INDIRECT:
+				append(text, "\taddress = aot_indirect(cpu, 0x%04X);\n", word);
+				break;
+			case INDIRECT_X:
+				append(text, "\taddress = aot_zero_page_word(cpu, 0x%02X + cpu->X_reg);\n", word&0xFF);
+				break;
+			case INDIRECT_Y:
+				append(text, "\taddress = aot_indexed(cpu, aot_zero_page_word(cpu, 0x%02X), cpu->Y_reg);\n", word&0xFF);
+				break;
+		}
+		append(text, "\tcpu->PC_reg = 0x%04X;\n", next_pc);
+	}
+
+	if(op->mode == IMMEDIATE){
+		sprintf(value, "0x%02X", word&0xFF);
+	} else {
+		sprintf(value, "bus_read(cpu->bus, %s)", address);
+	}
+
+	reg = register_name(name);
+	if(!strcmp(name, "lda") || !strcmp(name, "ldx") || !strcmp(name, "ldy")){
+		append(text, "\tcpu->%c_reg = %s;\n", reg, value);
+		append(text, "\taot_zero_negative(cpu, cpu->%c_reg);\n", reg);
+	} else if(!strcmp(name, "sta") || !strcmp(name, "stx") || !strcmp(name, "sty")){
+		append(text, "\tbus_write(cpu->bus, %s, cpu->%c_reg);\n", address, reg);
+	} else if(!strcmp(name, "and") || !strcmp(name, "ora") || !strcmp(name, "eor")){
+		append(text, "\tcpu->A_reg %c= %s;\n", name[0] == 'a' ? '&' : name[0] == 'o' ? '|' : '^', value);
+		append(text, "\taot_zero_negative(cpu, cpu->A_reg);\n");
+	} else if(!strcmp(name, "cmp") || !strcmp(name, "cpx") || !strcmp(name, "cpy")){
+		append(text, "\taot_compare(cpu, cpu->%c_reg, %s);\n", name[1] == 'm' ? 'A' : reg, value);
+	} else if(!strcmp(name, "inc") || !strcmp(name, "dec")){
+		append(text, "\tvalue = %s %c 1;\n", value, name[0] == 'i' ? '+' : '-');
+		append(text, "\tbus_write(cpu->bus, %s, value);\n", address);
+		append(text, "\taot_zero_negative(cpu, value);\n");
+		*uses_value = 1;
+	} else if(!strcmp(name, "inx") || !strcmp(name, "iny") || !strcmp(name, "dex") || !strcmp(name, "dey")){
+		append(text, "\tcpu->%c_reg%s;\n", reg, name[0] == 'i' ? "++" : "--");
+		append(text, "\taot_zero_negative(cpu, cpu->%c_reg);\n", reg);
+	} else if(!strcmp(name, "tax") || !strcmp(name, "tay") || !strcmp(name, "txa") || !strcmp(name, "tya") || !strcmp(name, "tsx")){
+		append(text, "\tcpu->%c_reg = cpu->%s_reg;\n", reg, name[1] == 's' ? "SP" : (char []) {toupper(name[1]), 0});
+		append(text, "\taot_zero_negative(cpu, cpu->%c_reg);\n", reg);
+	} else if(!strcmp(name, "txs")){
+		append(text, "\tcpu->SP_reg = cpu->X_reg;\n");
+	} else if(name[0] == 'c' && name[1] == 'l'){
+		append(text, "\tcpu->P_reg &= ~(1<<%s);\n", name[2] == 'c' ? "CARRY" : name[2] == 'd' ? "DECIMAL" : name[2] == 'i' ? "INTERRUPT" : "OVERFLOW");
+	} else if(name[0] == 's' && name[1] == 'e'){
+		append(text, "\tcpu->P_reg |= 1<<%s;\n", name[2] == 'c' ? "CARRY" : name[2] == 'd' ? "DECIMAL" : "INTERRUPT");
+	} else if(!strcmp(name, "nop")){
+	} else if(!strcmp(name, "jmp")){
+		append(text, "\tcpu->PC_reg = %s;\n", address);
+	} else {
+		append(text, "\t%s(cpu, %s);\n", name, address);
+	}
+
+	if(touches_memory){
+		if(op->page_penalty){
+			append(text, "\tcpu->cycles += %u + cpu->crossed_page;\n", op->cycles);
+		} else {
+			append(text, "\tcpu->cycles += %u;\n", op->cycles);
+		}
+		//Hand back to the host as soon as a device asks, as the interpreter does
+		if(!last){
+			append(text, "\tif(cpu->bus->event){\n\t\treturn;\n\t}\n");
+		}
+	} else {
+		*pending_cycles += op->cycles;
+	}
+
+	return !ends_block(name);
+}
+
+static void translate_block(FILE *out, uint16_t start){
+	TEXT text = {NULL, 0, 0};
+	const OPCODE *op;
+	const char *name;
+	unsigned int pc;
+	unsigned int length;
+	unsigned int num_instructions;
+	unsigned int pending_cycles;
+	unsigned int max_cycles;
+	unsigned char uses_value;
+	unsigned char ended;
+	unsigned char last;
+	int image;
+
+	image = image_at[start];
+	pc = start;
+	num_instructions = 0;
+	pending_cycles = 0;
+	max_cycles = 0;
+	uses_value = 0;
+	ended = 0;
+	while(!ended && num_instructions < MAX_BLOCK_INSTRUCTIONS){
+		op = decode_6502(memory[pc]);
+		if(!op){
+			break;
+		}
+		length = mode_lengths[op->mode];
+		name = operation_name(op);
+		if(pc + length - 1 > 0xFFFF || image_at[pc + length - 1] != image){
+			break;
+		}
+		last = ends_block(name) || num_instructions + 1 == MAX_BLOCK_INSTRUCTIONS || pc + length > 0xFFFF || image_at[pc + length] != image;
+		ended = !translate_instruction(&text, pc, op, name, &pending_cycles, &uses_value, last);
+		max_cycles += op->cycles + op->page_penalty + (op->mode == RELATIVE)*2;
+		num_instructions++;
+
+		if(branch_condition(name)){
+			queue_block(pc + length + (int8_t) memory[pc + 1]);
+			queue_block(pc + length);
+		} else if(!strcmp(name, "jsr")){
+			queue_block(memory[pc + 1] | memory[pc + 2]<<8);
+			//Assume the subroutine returns
+			queue_block(pc + length);
+		} else if(!strcmp(name, "jmp") && op->mode == ABSOLUTE){
+			queue_block(memory[pc + 1] | memory[pc + 2]<<8);
+		}
+		pc += length;
+		if(last){
+			break;
+		}
+	}
+
+	//The interpreter handles opcodes it doesn't know
+	if(!num_instructions){
+		free(text.data);
+		return;
+	}
+	if(pending_cycles){
+		append(&text, "\tcpu->cycles += %u;\n", pending_cycles);
+	}
+	if(!ended){
+		append(&text, "\tcpu->PC_reg = 0x%04X;\n", pc);
+		queue_block(pc);
+	}
+
+	fprintf(out, "static void block_%04X(CPU_6502 *cpu){\n", start);
+	if(strstr(text.data, "address")){
+		fprintf(out, "\tuint16_t address;\n");
+	}
+	if(uses_value){
+		fprintf(out, "\tuint8_t value;\n");
+	}
+	if(strstr(text.data, "address") || uses_value){
+		fprintf(out, "\n");
+	}
+	fputs(text.data, out);
+	fprintf(out, "}\n\n");
+	free(text.data);
+
+	block_addresses[num_blocks] = start;
+	block_cycles[num_blocks] = max_cycles;
+	num_blocks++;
+}
+
+int main(int argc, char **argv){
+	FILE *out;
+	unsigned int i;
+	unsigned int j;
+	unsigned int vector;
+
+	if(argc < 3){
+		fprintf(stderr, "Usage: %s OUTPUT FILE:ADDRESS:SIZE...\n", argv[0]);
+		return 1;
+	}
+	for(i = 0; i < 0x10000; i++){
+		image_at[i] = -1;
+	}
+	for(i = 2; i < (unsigned int) argc; i++){
+		if(!load_image(argv[i])){
+			return 1;
+		}
+	}
+
+	for(i = 0; i < num_images; i++){
+		queue_block(images[i].address);
+	}
+	for(vector = 0xFFFA; vector < 0x10000; vector += 2){
+		if(image_at[vector] >= 0 && image_at[vector + 1] >= 0){
+			queue_block(memory[vector] | memory[vector + 1]<<8);
+		}
+	}
+
+	out = fopen(argv[1], "w");
+	if(!out){
+		fprintf(stderr, "Could not open \"%s\"\n", argv[1]);
+		return 1;
+	}
+	fprintf(out, "/*\n * Translated ROM code\n *\n * Generated by aot_translate from");
+	for(i = 0; i < num_images; i++){
+		fprintf(out, "%s %s at %04X", i ? "," : "", images[i].file_name, images[i].address);
+	}
+	fprintf(out, ".\n * Don't edit, run \"make aot\" again instead.\n */\n\n");
+	fprintf(out, "#include <stdint.h>\n#include \"aot.h\"\n#include \"operations.h\"\n\n");
+
+	for(i = 0; i < num_images; i++){
+		fprintf(out, "static const uint8_t image_%u[0x%X] = {", i, images[i].size);
+		for(j = 0; j < images[i].size; j++){
+			fprintf(out, "%s0x%02X,", j%16 ? " " : "\n\t", memory[images[i].address + j]);
+		}
+		fprintf(out, "\n};\n\n");
+	}
+	fprintf(out, "const AOT_IMAGE aot_images[] = {\n");
+	for(i = 0; i < num_images; i++){
+		fprintf(out, "\t{0x%04X, 0x%X, image_%u},\n", images[i].address, images[i].size, i);
+	}
+	fprintf(out, "};\n\nconst unsigned int aot_num_images = %u;\n\n", num_images);
+
+	//Translating a block can find more
+	for(i = 0; i < num_pending_blocks; i++){
+		translate_block(out, pending_blocks[i]);
+	}
+
+	fprintf(out, "const AOT_BLOCK aot_blocks[] = {\n");
+	for(i = 0; i < num_blocks; i++){
+		fprintf(out, "\t{0x%04X, %d, %u, block_%04X},\n", block_addresses[i], image_at[block_addresses[i]], block_cycles[i], block_addresses[i]);
+	}
+	fprintf(out, "};\n\nconst unsigned int aot_num_blocks = %u;\n", num_blocks);
+	fclose(out);
+
+	fprintf(stderr, "Translated %u blocks\n", num_blocks);
+
+	return 0;
+}
@@ -0,0 +1,480 @@
+/*
+ * Batch runner
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "batch.h"
+#include "machine.h"
+#include "pace.h"
+
+typedef struct BATCH_JOB BATCH_JOB;
+
+struct BATCH_JOB{
+	unsigned int number;
+	char *source;
+	char *input;
+	char *output;
+	unsigned long long int cycle_limit;
+
+	//Set up once the job starts
+	MACHINE *machine;
+	FILE *output_file;
+	char *script;
+	size_t script_length;
+	size_t script_position;
+};
+
+typedef struct BATCH_QUEUE BATCH_QUEUE;
+
+//Jobs waiting to start. The owner takes from the bottom and thieves from the top.
+struct BATCH_QUEUE{
+	BATCH_JOB **jobs;
+	unsigned int top;
+	unsigned int bottom;
+	pthread_mutex_t lock;
+};
+
+typedef struct BATCH BATCH;
+
+struct BATCH{
+	BATCH_JOB *jobs;
+	unsigned int num_jobs;
+	BATCH_QUEUE *queues;
+	unsigned int num_threads;
+	unsigned char use_jit;
+
+	//Results are printed one at a time
+	pthread_mutex_t results_lock;
+	atomic_uint jobs_finished;
+	atomic_ullong cycles_run;
+	atomic_int failed;
+};
+
+typedef struct BATCH_WORKER BATCH_WORKER;
+
+struct BATCH_WORKER{
+	BATCH *batch;
+	unsigned int index;
+	pthread_t thread;
+};
+
+static char *copy_string(const char *string){
+	char *copy;
+
+	copy = malloc(strlen(string) + 1);
+	if(copy){
+		strcpy(copy, string);
+	}
+	return copy;
+}
+
+//Returns 0 if the manifest couldn't be read
+static int read_manifest(BATCH *batch, const char *manifest_name){
+	char line[BATCH_MAX_LINE];
+	char source[BATCH_MAX_LINE];
+	char input[BATCH_MAX_LINE];
+	char output[BATCH_MAX_LINE];
+	unsigned long long int cycle_limit;
+	unsigned int line_number;
+	unsigned int capacity;
+	BATCH_JOB *new_jobs;
+	BATCH_JOB *job;
+	FILE *fp;
+	int fields;
+
+	batch->jobs = NULL;
+	batch->num_jobs = 0;
+	fp = fopen(manifest_name, "r");
+	if(!fp){
+		fprintf(stderr, "Could not open manifest \"%s\"\n", manifest_name);
+		return 0;
+	}
+
+	capacity = 0;
+	line_number = 0;
+	while(fgets(line, sizeof(line), fp)){
+		line_number++;
+		fields = sscanf(line, "%s %s %llu %s", source, input, &cycle_limit, output);
+		if(fields <= 0 || source[0] == '#'){
+			continue;
+		}
+		if(fields != 4){
+			fprintf(stderr, "%s:%u: expected SOURCE INPUT CYCLES OUTPUT\n", manifest_name, line_number);
+			fclose(fp);
+			return 0;
+		}
+
+		if(batch->num_jobs == capacity){
+			capacity = capacity ? capacity*2 : 64;
+			new_jobs = realloc(batch->jobs, sizeof(BATCH_JOB)*capacity);
+			if(!new_jobs){
+				fclose(fp);
+				return 0;
+			}
+			batch->jobs = new_jobs;
+		}
+		job = batch->jobs + batch->num_jobs;
+		memset(job, 0, sizeof(BATCH_JOB));
+		job->number = batch->num_jobs + 1;
+		job->source = copy_string(source);
+		job->input = copy_string(input);
+		job->output = copy_string(output);
+		job->cycle_limit = cycle_limit;
+		//Counted before checking so whatever was copied gets freed
+		batch->num_jobs++;
+		if(!job->source || !job->input || !job->output){
+			fclose(fp);
+			return 0;
+		}
+	}
+	fclose(fp);
+
+	return 1;
+}
+
+//Free the jobs and queues, which may only be partly set up
+static void free_batch(BATCH *batch){
+	unsigned int i;
+
+	for(i = 0; i < batch->num_jobs; i++){
+		free(batch->jobs[i].source);
+		free(batch->jobs[i].input);
+		free(batch->jobs[i].output);
+	}
+	free(batch->jobs);
+	batch->jobs = NULL;
+	if(batch->queues){
+		for(i = 0; i < batch->num_threads; i++){
+			free(batch->queues[i].jobs);
+		}
+		free(batch->queues);
+		batch->queues = NULL;
+	}
+}
+
+//Load the ROMs in a directory the same way the emulator loads its own
+static int boot_from_directory(MACHINE *machine, const char *directory){
+	char file_name[BATCH_MAX_LINE + 16];
+
+	snprintf(file_name, sizeof(file_name), "%s/BASIC", directory);
+	machine->basic_loaded = machine_load_rom(machine, file_name, 0xE000, 0x1000);
+	snprintf(file_name, sizeof(file_name), "%s/WOZACI", directory);
+	if(!machine_load_rom(machine, file_name, 0xC000, 0x100)){
+		return 0;
+	}
+	snprintf(file_name, sizeof(file_name), "%s/WOZMON", directory);
+	if(!machine_load_rom(machine, file_name, 0xFF00, 0x100)){
+		return 0;
+	}
+	machine_map(machine, 0);
+	machine_reset(machine);
+
+	return 1;
+}
+
+static int read_script(BATCH_JOB *job){
+	FILE *fp;
+	long length;
+
+	if(!strcmp(job->input, "-")){
+		return 1;
+	}
+	fp = fopen(job->input, "rb");
+	if(!fp){
+		return 0;
+	}
+	if(fseek(fp, 0, SEEK_END) || (length = ftell(fp)) < 0 || fseek(fp, 0, SEEK_SET)){
+		fclose(fp);
+		return 0;
+	}
+	job->script = malloc(length + 1);
+	if(!job->script || fread(job->script, 1, length, fp) != (size_t) length){
+		fclose(fp);
+		return 0;
+	}
+	fclose(fp);
+	job->script_length = length;
+
+	return 1;
+}
+
+//Returns 0 if the job couldn't be set up
+static int start_job(BATCH *batch, BATCH_JOB *job){
+	struct stat source_stat;
+
+	job->machine = malloc(sizeof(MACHINE));
+	if(!job->machine){
+		return 0;
+	}
+	machine_init(job->machine, 0);
+	if(batch->use_jit){
+		machine_enable_jit(job->machine);
+	}
+
+	if(!stat(job->source, &source_stat) && S_ISDIR(source_stat.st_mode)){
+		if(!boot_from_directory(job->machine, job->source)){
+			return 0;
+		}
+	} else {
+		if(!machine_load_snapshot(job->machine, job->source)){
+			return 0;
+		}
+		machine_map(job->machine, 0);
+	}
+
+	if(!read_script(job)){
+		return 0;
+	}
+	job->output_file = fopen(job->output, "w");
+	if(!job->output_file){
+		return 0;
+	}
+	job->machine->display.output = job->output_file;
+
+	return 1;
+}
+
+//Run the job for a slice. Returns the reason it ended, or NULL if it hasn't.
+static const char *run_job(BATCH_JOB *job){
+	MACHINE *machine = job->machine;
+
+	//Keep the keyboard queue topped up from the script
+	while(job->script_position < job->script_length){
+		if(job->script[job->script_position] != '\r' && !keyboard_type(&machine->keyboard, job->script[job->script_position])){
+			break;
+		}
+		job->script_position++;
+	}
+
+	machine_run(machine, BATCH_SLICE_CYCLES);
+
+	if(machine->cpu.halted){
+		return "halted";
+	}
+	if(job->cycle_limit && machine->cpu.cycles >= job->cycle_limit){
+		return "cycles";
+	}
+	if(machine->keyboard.idle){
+		if(job->script_position >= job->script_length){
+			return "done";
+		}
+		keyboard_wake(&machine->keyboard);
+	}
+
+	return NULL;
+}
+
+static void finish_job(BATCH *batch, BATCH_JOB *job, const char *status){
+	unsigned long long int cycles = 0;
+
+	if(job->machine){
+		cycles = job->machine->cpu.cycles;
+		if(job->output_file){
+			display_flush(&job->machine->display);
+		}
+		machine_free(job->machine);
+		free(job->machine);
+		job->machine = NULL;
+	}
+	if(job->output_file){
+		fclose(job->output_file);
+		job->output_file = NULL;
+	}
+	free(job->script);
+	job->script = NULL;
+
+	if(!strcmp(status, "error") || !strcmp(status, "halted")){
+		atomic_store(&batch->failed, 1);
+	}
+	atomic_fetch_add(&batch->cycles_run, cycles);
+
+	pthread_mutex_lock(&batch->results_lock);
+	printf("%u %s %llu %s\n", job->number, status, cycles, job->output);
+	fflush(stdout);
+	atomic_fetch_add(&batch->jobs_finished, 1);
+	pthread_mutex_unlock(&batch->results_lock);
+}
+
+//Take a job from our own queue, or if allowed steal one from another worker's
+static BATCH_JOB *take_job(BATCH_WORKER *worker, unsigned char steal){
+	BATCH *batch = worker->batch;
+	BATCH_QUEUE *queue;
+	BATCH_JOB *job;
+	unsigned int i;
+
+	queue = batch->queues + worker->index;
+	job = NULL;
+	pthread_mutex_lock(&queue->lock);
+	if(queue->bottom > queue->top){
+		queue->bottom--;
+		job = queue->jobs[queue->bottom];
+	}
+	pthread_mutex_unlock(&queue->lock);
+
+	for(i = 1; !job && steal && i < batch->num_threads; i++){
+		queue = batch->queues + (worker->index + i)%batch->num_threads;
+		pthread_mutex_lock(&queue->lock);
+		if(queue->bottom > queue->top){
+			job = queue->jobs[queue->top];
+			queue->top++;
+		}
+		pthread_mutex_unlock(&queue->lock);
+	}
+
+	return job;
+}
+
+static void *batch_worker(void *argument){
+	BATCH_WORKER *worker = argument;
+	BATCH_JOB *active[BATCH_ACTIVE_JOBS];
+	BATCH_JOB *job;
+	unsigned int num_active;
+	unsigned int i;
+	const char *status;
+
+	num_active = 0;
+	while(1){
+		//Started jobs never move, so a thief only takes one at a time and leaves the rest for other idle workers
+		while(num_active < BATCH_ACTIVE_JOBS && (job = take_job(worker, !num_active))){
+			if(start_job(worker->batch, job)){
+				active[num_active] = job;
+				num_active++;
+			} else {
+				finish_job(worker->batch, job, "error");
+			}
+		}
+		//Every queue is empty, so nothing is left to do
+		if(!num_active){
+			break;
+		}
+
+		i = 0;
+		while(i < num_active){
+			status = run_job(active[i]);
+			if(status){
+				finish_job(worker->batch, active[i], status);
+				num_active--;
+				active[i] = active[num_active];
+			} else {
+				i++;
+			}
+		}
+	}
+
+	return NULL;
+}
+
+int run_batch(const char *manifest_name, unsigned int num_threads, unsigned char show_stats, unsigned char use_jit){
+	BATCH batch;
+	BATCH_WORKER *workers;
+	BATCH_JOB *temp;
+	long long int start_time;
+	long long int last_report;
+	double seconds;
+	unsigned int i;
+	unsigned int j;
+	unsigned int num_queue_jobs;
+	unsigned int num_started;
+
+	batch.queues = NULL;
+	batch.num_threads = 0;
+	if(!read_manifest(&batch, manifest_name)){
+		free_batch(&batch);
+		return 1;
+	}
+
+	if(!num_threads){
+#ifdef _SC_NPROCESSORS_ONLN
+		num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+		if(!num_threads){
+			num_threads = 1;
+		}
+	}
+	batch.use_jit = use_jit;
+	//Cleared so a partly set up batch can be freed
+	batch.queues = calloc(num_threads, sizeof(BATCH_QUEUE));
+	batch.num_threads = num_threads;
+	workers = malloc(sizeof(BATCH_WORKER)*num_threads);
+	if(!batch.queues || !workers){
+		free(workers);
+		free_batch(&batch);
+		return 1;
+	}
+	pthread_mutex_init(&batch.results_lock, NULL);
+	atomic_init(&batch.jobs_finished, 0);
+	atomic_init(&batch.cycles_run, 0);
+	atomic_init(&batch.failed, 0);
+
+	//Deal the jobs out in turn
+	for(i = 0; i < num_threads; i++){
+		batch.queues[i].jobs = malloc(sizeof(BATCH_JOB *)*(batch.num_jobs/num_threads + 1));
+		if(!batch.queues[i].jobs){
+			free(workers);
+			free_batch(&batch);
+			return 1;
+		}
+		batch.queues[i].top = 0;
+		batch.queues[i].bottom = 0;
+		pthread_mutex_init(&batch.queues[i].lock, NULL);
+	}
+	for(i = 0; i < batch.num_jobs; i++){
+		num_queue_jobs = batch.queues[i%num_threads].bottom;
+		//Kept in reverse so the owner starts with the first job it was dealt
+		batch.queues[i%num_threads].jobs[num_queue_jobs] = batch.jobs + i;
+		batch.queues[i%num_threads].bottom++;
+	}
+	for(i = 0; i < num_threads; i++){
+		num_queue_jobs = batch.queues[i].bottom;
+		for(j = 0; j < num_queue_jobs/2; j++){
+			temp = batch.queues[i].jobs[j];
+			batch.queues[i].jobs[j] = batch.queues[i].jobs[num_queue_jobs - 1 - j];
+			batch.queues[i].jobs[num_queue_jobs - 1 - j] = temp;
+		}
+	}
+
+	start_time = pace_now();
+	//The workers that did start steal the jobs dealt to any that didn't
+	num_started = 0;
+	for(i = 0; i < num_threads; i++){
+		workers[i].batch = &batch;
+		workers[i].index = i;
+		if(pthread_create(&workers[i].thread, NULL, batch_worker, workers + i)){
+			fprintf(stderr, "Could not start thread %u of %u\n", i + 1, num_threads);
+			break;
+		}
+		num_started++;
+	}
+	//Without any threads the jobs still run, here
+	if(!num_started){
+		batch_worker(workers);
+	}
+
+	//Report progress while the workers run
+	last_report = start_time;
+	while(show_stats && atomic_load(&batch.jobs_finished) < batch.num_jobs){
+		usleep(100000);
+		if(pace_now() - last_report >= PACE_RATE_PERIOD){
+			last_report = pace_now();
+			seconds = (last_report - start_time)/1000000000.0;
+			fprintf(stderr, "%u/%u jobs, %.3f MHz\n", atomic_load(&batch.jobs_finished), batch.num_jobs, atomic_load(&batch.cycles_run)/seconds/1000000.0);
+		}
+	}
+	for(i = 0; i < num_started; i++){
+		pthread_join(workers[i].thread, NULL);
+	}
+
+	seconds = (pace_now() - start_time)/1000000000.0;
+	fprintf(stderr, "Ran %u jobs on %u threads: %llu cycles in %.3f s, %.3f MHz\n", batch.num_jobs, num_started ? num_started : 1, (unsigned long long int) atomic_load(&batch.cycles_run), seconds, seconds > 0 ? atomic_load(&batch.cycles_run)/seconds/1000000.0 : 0.0);
+
+	free(workers);
+	free_batch(&batch);
+
+	return atomic_load(&batch.failed);
+}
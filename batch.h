@@ -0,0 +1,38 @@
+/*
+ * Batch runner
+ *
+ * Runs a manifest of independent jobs on a pool of worker threads, each
+ * job on a machine of its own. A manifest has one job per line:
+ *
+ *     SOURCE INPUT CYCLES OUTPUT
+ *
+ * SOURCE is a directory holding the ROMs to boot from, or a snapshot to
+ * start from. INPUT is a file of keys to type, or - for none. The job
+ * ends after CYCLES cycles, or 0 for no limit, or once all of its input
+ * has been typed and the program sits waiting for more. Everything the
+ * Apple 1 displays goes to OUTPUT. Blank lines and lines starting with #
+ * are ignored.
+ *
+ * Jobs are dealt out to per-worker queues up front. A worker that runs
+ * out of jobs steals one at a time from the other end of another worker's
+ * queue. Each worker keeps a few of its own jobs going at once and runs
+ * them a slice at a time, so long jobs don't hold up the results of short
+ * ones.
+ */
+
+#ifndef BATCH_H
+#define BATCH_H
+
+//Cycles a job runs before its worker moves on to the next one
+#define BATCH_SLICE_CYCLES 5000
+
+//Jobs a worker has going at once
+#define BATCH_ACTIVE_JOBS 4
+
+#define BATCH_MAX_LINE 4096
+
+//Returns the exit status: 0 if every job ran, 1 otherwise
+//num_threads of 0 uses one thread per processor
+int run_batch(const char *manifest_name, unsigned int num_threads, unsigned char show_stats, unsigned char use_jit);
+
+#endif
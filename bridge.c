@@ -0,0 +1,129 @@
+/*
+ * Host file bridge
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include "bridge.h"
+
+void bridge_init(BRIDGE *bridge, BUS *bus, uint8_t *memory){
+	int i;
+
+	for(i = 0; i < BRIDGE_NUM_REGISTERS; i++){
+		bridge->registers[i] = 0;
+	}
+	bridge->bus = bus;
+	bridge->memory = memory;
+}
+
+static uint16_t get_register_word(BRIDGE *bridge, uint8_t offset){
+	return bridge->registers[offset] | bridge->registers[offset + 1]<<8;
+}
+
+//Copy the file name out of the Apple 1's memory, dropping the high bit the keyboard sets
+static void get_file_name(BRIDGE *bridge, char *file_name){
+	uint16_t address;
+	int i;
+
+	address = get_register_word(bridge, BRIDGE_NAME);
+	for(i = 0; i < BRIDGE_MAX_NAME - 1; i++){
+		file_name[i] = bridge->memory[(uint16_t) (address + i)]&0x7F;
+		if(file_name[i] == (char) 0 || file_name[i] == '\r'){
+			break;
+		}
+	}
+	file_name[i] = (char) 0;
+}
+
+//Whether every page of the block is RAM
+static int is_ram_block(BRIDGE *bridge, uint16_t start, uint16_t end){
+	unsigned int page;
+
+	for(page = start>>8; page <= (unsigned int) (end>>8); page++){
+		if(!is_ram_page(bridge->bus, page)){
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+static size_t load_block(BRIDGE *bridge, FILE *fp, uint16_t start, uint16_t end){
+	uint8_t chunk[4096];
+	size_t count;
+	size_t length;
+	size_t i;
+
+	count = 0;
+	while(count < (size_t) (end - start + 1)){
+		length = end - start + 1 - count;
+		if(length > sizeof(chunk)){
+			length = sizeof(chunk);
+		}
+		length = fread(chunk, 1, length, fp);
+		if(!length){
+			break;
+		}
+		for(i = 0; i < length; i++){
+			bus_write(bridge->bus, start + count + i, chunk[i]);
+		}
+		count += length;
+	}
+
+	return count;
+}
+
+static void bridge_command(BRIDGE *bridge, uint8_t command){
+	char file_name[BRIDGE_MAX_NAME];
+	FILE *fp;
+	uint16_t start;
+	uint16_t end;
+	size_t count;
+
+	start = get_register_word(bridge, BRIDGE_START);
+	end = get_register_word(bridge, BRIDGE_END);
+	count = 0;
+	if((command != BRIDGE_LOAD && command != BRIDGE_SAVE) || end < start){
+		bridge->registers[BRIDGE_STATUS] = BRIDGE_BAD_COMMAND;
+	} else if(command == BRIDGE_LOAD && !is_ram_block(bridge, start, end)){
+		bridge->registers[BRIDGE_STATUS] = BRIDGE_BAD_RANGE;
+	} else {
+		get_file_name(bridge, file_name);
+		fp = fopen(file_name, command == BRIDGE_LOAD ? "rb" : "wb");
+		if(!fp){
+			bridge->registers[BRIDGE_STATUS] = BRIDGE_FILE_ERROR;
+		} else if(command == BRIDGE_LOAD){
+			//A file shorter than the block fills the start of it
+			count = load_block(bridge, fp, start, end);
+			bridge->registers[BRIDGE_STATUS] = ferror(fp) ? BRIDGE_FILE_ERROR : BRIDGE_OK;
+			fclose(fp);
+		} else {
+			count = fwrite(bridge->memory + start, 1, end - start + 1, fp);
+			bridge->registers[BRIDGE_STATUS] = count == (size_t) (end - start + 1) ? BRIDGE_OK : BRIDGE_FILE_ERROR;
+			if(fclose(fp)){
+				bridge->registers[BRIDGE_STATUS] = BRIDGE_FILE_ERROR;
+			}
+		}
+	}
+
+	bridge->registers[BRIDGE_COUNT] = count;
+	bridge->registers[BRIDGE_COUNT + 1] = count>>8;
+	bridge->registers[BRIDGE_COUNT + 2] = count>>16;
+}
+
+uint8_t bridge_read(BRIDGE *bridge, uint8_t offset){
+	if(offset >= BRIDGE_NUM_REGISTERS){
+		return 0;
+	}
+	return bridge->registers[offset];
+}
+
+void bridge_write(BRIDGE *bridge, uint8_t offset, uint8_t value){
+	if(offset == BRIDGE_STATUS || offset >= BRIDGE_COUNT){
+		return;
+	}
+	bridge->registers[offset] = value;
+	if(offset == BRIDGE_COMMAND){
+		bridge_command(bridge, value);
+	}
+}
@@ -0,0 +1,68 @@
+/*
+ * Host file bridge
+ *
+ * A device that lets programs running on the Apple 1 load and save
+ * blocks of memory as files on the host in a single step. The program
+ * fills in the registers and then writes a command:
+ *
+ *     +0 +1  address of the file name, ending in a zero or carriage return
+ *     +2 +3  first address of the block
+ *     +4 +5  last address of the block
+ *     +6     command: BRIDGE_LOAD or BRIDGE_SAVE
+ *     +7     status of the last command
+ *     +8 +9 +10  number of bytes the last command transferred
+ *
+ * Addresses are little endian, like everything else on the 6502. The
+ * count has a third byte since saving all of memory moves 0x10000 bytes.
+ *
+ * Loads go through the bus, and only into RAM. A block that covers any
+ * ROM or device page isn't loaded at all.
+ */
+
+#ifndef BRIDGE_H
+#define BRIDGE_H
+
+#include <stdint.h>
+#include "bus.h"
+
+//The bridge lives in the otherwise unused I/O page 0xC2
+#define BRIDGE_PAGE 0xC2
+
+#define BRIDGE_NAME 0
+#define BRIDGE_START 2
+#define BRIDGE_END 4
+#define BRIDGE_COMMAND 6
+#define BRIDGE_STATUS 7
+#define BRIDGE_COUNT 8
+#define BRIDGE_NUM_REGISTERS 11
+
+//Commands
+#define BRIDGE_LOAD 1
+#define BRIDGE_SAVE 2
+
+//Status
+#define BRIDGE_OK 0
+#define BRIDGE_FILE_ERROR 1
+#define BRIDGE_BAD_COMMAND 2
+#define BRIDGE_BAD_RANGE 3
+
+#define BRIDGE_MAX_NAME 256
+
+typedef struct BRIDGE BRIDGE;
+
+struct BRIDGE{
+	uint8_t registers[BRIDGE_NUM_REGISTERS];
+	//Loaded blocks are written through the bus, so ROM and devices stay out of reach and decoded code is dropped
+	BUS *bus;
+	//The Apple 1's memory that saved blocks and file names are read from
+	uint8_t *memory;
+};
+
+void bridge_init(BRIDGE *bridge, BUS *bus, uint8_t *memory);
+
+uint8_t bridge_read(BRIDGE *bridge, uint8_t offset);
+
+//Writing the command register carries out the command
+void bridge_write(BRIDGE *bridge, uint8_t offset, uint8_t value);
+
+#endif
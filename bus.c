@@ -0,0 +1,171 @@
+/*
+ * Page-mapped memory bus
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include "bus.h"
+
+static uint8_t read_memory(void *context, uint16_t address){
+	BUS *bus = context;
+
+	return bus->page_data[address>>8][address&0xFF];
+}
+
+static void write_memory(void *context, uint16_t address, uint8_t value){
+	BUS *bus = context;
+
+	bus->page_data[address>>8][address&0xFF] = value;
+}
+
+static void write_ignore(void *context, uint16_t address, uint8_t value){
+}
+
+static uint8_t read_open(void *context, uint16_t address){
+	return 0;
+}
+
+//Point the direct access tables at the backing store of a page, unless it is a device or being traced
+//Writes to pages holding translated code have to be seen, so they go through the handler
+static void update_page(BUS *bus, uint8_t page){
+	if(bus->trace || !bus->page_data[page]){
+		bus->read_pages[page] = NULL;
+		bus->write_pages[page] = NULL;
+	} else {
+		bus->read_pages[page] = bus->page_data[page];
+		if(bus->write_handlers[page] == write_memory && !bus->code_pages[page]){
+			bus->write_pages[page] = bus->page_data[page];
+		} else {
+			bus->write_pages[page] = NULL;
+		}
+	}
+}
+
+void bus_init(BUS *bus){
+	unsigned int i;
+
+	bus->trace = NULL;
+	bus->trace_context = NULL;
+	bus->event = 0;
+	for(i = 0; i < BUS_MAX_CODE_WATCHERS; i++){
+		bus->code_write[i] = NULL;
+		bus->code_context[i] = NULL;
+	}
+	for(i = 0; i < 256; i++){
+		bus->page_data[i] = NULL;
+		bus->code_pages[i] = 0;
+		bus->read_handlers[i] = read_open;
+		bus->write_handlers[i] = write_ignore;
+		bus->contexts[i] = bus;
+		update_page(bus, i);
+	}
+}
+
+void map_ram(BUS *bus, uint8_t page, unsigned int num_pages, uint8_t *data){
+	unsigned int i;
+
+	for(i = 0; i < num_pages; i++){
+		bus->page_data[page + i] = data + i*0x100;
+		bus->read_handlers[page + i] = read_memory;
+		bus->write_handlers[page + i] = write_memory;
+		bus->contexts[page + i] = bus;
+		update_page(bus, page + i);
+	}
+}
+
+void map_rom(BUS *bus, uint8_t page, unsigned int num_pages, uint8_t *data){
+	unsigned int i;
+
+	for(i = 0; i < num_pages; i++){
+		bus->page_data[page + i] = data + i*0x100;
+		bus->read_handlers[page + i] = read_memory;
+		bus->write_handlers[page + i] = write_ignore;
+		bus->contexts[page + i] = bus;
+		update_page(bus, page + i);
+	}
+}
+
+void map_device(BUS *bus, uint8_t page, READ_HANDLER read, WRITE_HANDLER write, void *context){
+	bus->page_data[page] = NULL;
+	bus->read_handlers[page] = read;
+	bus->write_handlers[page] = write;
+	bus->contexts[page] = context;
+	update_page(bus, page);
+}
+
+void set_bus_trace(BUS *bus, TRACE_HANDLER trace, void *context){
+	unsigned int i;
+
+	bus->trace = trace;
+	bus->trace_context = context;
+	for(i = 0; i < 256; i++){
+		update_page(bus, i);
+	}
+}
+
+int add_code_watcher(BUS *bus, CODE_WRITE_HANDLER handler, void *context){
+	int i;
+
+	for(i = 0; i < BUS_MAX_CODE_WATCHERS; i++){
+		if(!bus->code_write[i]){
+			bus->code_write[i] = handler;
+			bus->code_context[i] = context;
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+void remove_code_watcher(BUS *bus, int watcher){
+	unsigned int i;
+
+	for(i = 0; i < 256; i++){
+		if(bus->code_pages[i]&(1<<watcher)){
+			protect_code_page(bus, i, watcher, 0);
+		}
+	}
+	bus->code_write[watcher] = NULL;
+	bus->code_context[watcher] = NULL;
+}
+
+void protect_code_page(BUS *bus, uint8_t page, int watcher, unsigned char protect){
+	if(protect){
+		bus->code_pages[page] |= 1<<watcher;
+	} else {
+		bus->code_pages[page] &= ~(1<<watcher);
+	}
+	update_page(bus, page);
+}
+
+int is_ram_page(BUS *bus, uint8_t page){
+	return bus->page_data[page] && bus->write_handlers[page] == write_memory;
+}
+
+uint8_t bus_read_slow(BUS *bus, uint16_t address){
+	uint8_t value;
+
+	value = bus->read_handlers[address>>8](bus->contexts[address>>8], address);
+	if(bus->trace){
+		bus->trace(bus->trace_context, address, value, 0);
+	}
+	return value;
+}
+
+void bus_write_slow(BUS *bus, uint16_t address, uint8_t value){
+	uint8_t watchers;
+	int i;
+
+	if(bus->trace){
+		bus->trace(bus->trace_context, address, value, 1);
+	}
+	//Whatever holds code from this page drops it before it changes
+	watchers = bus->code_pages[address>>8];
+	for(i = 0; watchers; i++){
+		if(watchers&(1<<i)){
+			bus->code_write[i](bus->code_context[i], address);
+			watchers &= ~(1<<i);
+		}
+	}
+	bus->write_handlers[address>>8](bus->contexts[address>>8], address, value);
+}
@@ -0,0 +1,106 @@
+/*
+ * Memory bus
+ *
+ * The address space is split into 256 pages. A page backed by RAM or ROM
+ * has a direct pointer in read_pages/write_pages, so the CPU core's
+ * accesses inline down to one table lookup and an array load or store.
+ * Pages without a direct pointer go to their device's handlers.
+ *
+ * Each machine has its own bus, and every handler is passed the context
+ * its page was mapped with, so several machines can share a process.
+ */
+
+#ifndef BUS_H
+#define BUS_H
+
+#include <stdint.h>
+
+//Most translators of code that can watch for writes over it at once
+#define BUS_MAX_CODE_WATCHERS 8
+
+typedef uint8_t (*READ_HANDLER)(void *context, uint16_t address);
+typedef void (*WRITE_HANDLER)(void *context, uint16_t address, uint8_t value);
+typedef void (*TRACE_HANDLER)(void *context, uint16_t address, uint8_t value, unsigned char is_write);
+typedef void (*CODE_WRITE_HANDLER)(void *context, uint16_t address);
+
+typedef struct BUS BUS;
+
+struct BUS{
+	//Direct pointers to the start of each page, or NULL if accesses need a handler
+	uint8_t *read_pages[256];
+	uint8_t *write_pages[256];
+
+	READ_HANDLER read_handlers[256];
+	WRITE_HANDLER write_handlers[256];
+	void *contexts[256];
+
+	//Backing store of RAM and ROM pages, kept so direct access can be turned back on after tracing
+	uint8_t *page_data[256];
+
+	TRACE_HANDLER trace;
+	void *trace_context;
+
+	//Pages of RAM holding decoded or translated code, with a bit for each watcher that holds some
+	//Writes to them take the slow path and are reported to those watchers first.
+	uint8_t code_pages[256];
+	CODE_WRITE_HANDLER code_write[BUS_MAX_CODE_WATCHERS];
+	void *code_context[BUS_MAX_CODE_WATCHERS];
+
+	//Set by a device to make run_6502 return to the host early
+	unsigned char event;
+};
+
+//Start with nothing mapped
+void bus_init(BUS *bus);
+
+//Map pages of RAM starting at page, backed by data
+void map_ram(BUS *bus, uint8_t page, unsigned int num_pages, uint8_t *data);
+
+//Map read-only pages starting at page, backed by data. Writes are ignored.
+void map_rom(BUS *bus, uint8_t page, unsigned int num_pages, uint8_t *data);
+
+//Map a memory-mapped device onto a page
+void map_device(BUS *bus, uint8_t page, READ_HANDLER read, WRITE_HANDLER write, void *context);
+
+//Send every access through trace as well, or stop tracing if trace is NULL
+void set_bus_trace(BUS *bus, TRACE_HANDLER trace, void *context);
+
+//Have writes to the pages a watcher marks reported to handler
+//Returns the watcher's number, or -1 if there are too many
+int add_code_watcher(BUS *bus, CODE_WRITE_HANDLER handler, void *context);
+
+//Stop reporting writes to a watcher and clear all its marks
+void remove_code_watcher(BUS *bus, int watcher);
+
+//Mark a page of RAM as holding a watcher's code, or clear the mark
+void protect_code_page(BUS *bus, uint8_t page, int watcher, unsigned char protect);
+
+//Whether a page is RAM, which the program can change under the CPU
+int is_ram_page(BUS *bus, uint8_t page);
+
+uint8_t bus_read_slow(BUS *bus, uint16_t address);
+
+void bus_write_slow(BUS *bus, uint16_t address, uint8_t value);
+
+static inline uint8_t bus_read(BUS *bus, uint16_t address){
+	uint8_t *page;
+
+	page = bus->read_pages[address>>8];
+	if(page){
+		return page[address&0xFF];
+	}
+	return bus_read_slow(bus, address);
+}
+
+static inline void bus_write(BUS *bus, uint16_t address, uint8_t value){
+	uint8_t *page;
+
+	page = bus->write_pages[address>>8];
+	if(page){
+		page[address&0xFF] = value;
+	} else {
+		bus_write_slow(bus, address, value);
+	}
+}
+
+#endif
@@ -13,1643 +13,997 @@
 #include <string.h>
 #include <sys/time.h>
 #include "cpu.h"
+#include "bus.h"
+#include "operations.h"
 
-#ifdef _WIN32
+//Number of bytes of each addressing mode, including the opcode
+const unsigned char mode_lengths[12] = {1, 2, 2, 2, 2, 3, 3, 3, 3, 2, 2, 2};
 
-#include <curses.h>
+unsigned char different_page(uint16_t address1, uint16_t address2){
+	return (address1&0xFF00) != (address2&0xFF00);
+}
 
-#else
+uint16_t get_word(CPU_6502 *cpu, uint16_t address){
+	return ((uint16_t) bus_read(cpu->bus, address)) | (((uint16_t) bus_read(cpu->bus, address + 1))<<8);
+}
 
-#include <ncurses.h>
+//Read a pointer out of the zero page, wrapping around at the end of the page
+uint16_t get_zero_page_word(CPU_6502 *cpu, uint8_t address){
+	return ((uint16_t) bus_read(cpu->bus, address)) | (((uint16_t) bus_read(cpu->bus, (uint8_t) (address + 1)))<<8);
+}
 
-#endif
+uint16_t get_indexed(CPU_6502 *cpu, uint16_t address1, uint8_t index){
+	uint16_t address2;
 
-unsigned char CROSSED_PAGE;
+	address2 = address1 + index;
+	cpu->crossed_page = different_page(address1, address2);
 
-unsigned char different_page(uint16_t address1, uint16_t address2){
-	return (address1&0xFF00) != (address2&0xFF00);
+	return address2;
 }
 
-uint8_t get_absolute(CPU_6502 *cpu, uint8_t index, uint8_t (*read)(uint16_t)){
+//Resolve the effective address of the instruction at PC
+uint16_t get_address(CPU_6502 *cpu, unsigned char mode){
 	uint16_t address1;
-	uint16_t address2;
+	uint8_t value1;
 
-	address1 = ((uint16_t) read(cpu->PC_reg + 1)) | (((uint16_t) read(cpu->PC_reg + 2))<<8);
-	address2 = address1 + index;
+	switch(mode){
+		case IMMEDIATE:
+			return cpu->PC_reg + 1;
+		case ZERO_PAGE:
+			return bus_read(cpu->bus, cpu->PC_reg + 1);
+		case ZERO_PAGE_X:
+			return (bus_read(cpu->bus, cpu->PC_reg + 1) + cpu->X_reg)&0xFF;
+		case ZERO_PAGE_Y:
+			return (bus_read(cpu->bus, cpu->PC_reg + 1) + cpu->Y_reg)&0xFF;
+		case ABSOLUTE:
+			return get_word(cpu, cpu->PC_reg + 1);
+		case ABSOLUTE_X:
+			return get_indexed(cpu, get_word(cpu, cpu->PC_reg + 1), cpu->X_reg);
+		case ABSOLUTE_Y:
+			return get_indexed(cpu, get_word(cpu, cpu->PC_reg + 1), cpu->Y_reg);
+		case INDIRECT:
+			//The 6502 doesn't carry into the high byte of the pointer when fetching it
+			address1 = get_word(cpu, cpu->PC_reg + 1);
+			return ((uint16_t) bus_read(cpu->bus, address1)) | (((uint16_t) bus_read(cpu->bus, (address1&0xFF00) | ((address1 + 1)&0xFF)))<<8);
+		case INDIRECT_X:
+			return get_zero_page_word(cpu, bus_read(cpu->bus, cpu->PC_reg + 1) + cpu->X_reg);
+		case INDIRECT_Y:
+			return get_indexed(cpu, get_zero_page_word(cpu, bus_read(cpu->bus, cpu->PC_reg + 1)), cpu->Y_reg);
+		case RELATIVE:
+			value1 = bus_read(cpu->bus, cpu->PC_reg + 1);
+			return cpu->PC_reg + 2 + (int8_t) value1;
+		default:
+			return 0;
+	}
+}
 
-	CROSSED_PAGE = different_page(address1, address2);
+//Read the operand of the instruction at PC, or the effective address if the addressing mode fixes it
+static uint16_t get_operand(CPU_6502 *cpu, unsigned char mode){
+	switch(mode){
+		case ZERO_PAGE_X:
+		case ZERO_PAGE_Y:
+		case INDIRECT_X:
+		case INDIRECT_Y:
+			return bus_read(cpu->bus, cpu->PC_reg + 1);
+		case ABSOLUTE_X:
+		case ABSOLUTE_Y:
+		case INDIRECT:
+			return get_word(cpu, cpu->PC_reg + 1);
+		default:
+			return get_address(cpu, mode);
+	}
+}
 
-	return read(address2);
+//Finish resolving the effective address from what get_operand read
+static inline uint16_t resolve_operand(CPU_6502 *cpu, unsigned char mode, uint16_t operand){
+	switch(mode){
+		case ZERO_PAGE_X:
+			return (operand + cpu->X_reg)&0xFF;
+		case ZERO_PAGE_Y:
+			return (operand + cpu->Y_reg)&0xFF;
+		case ABSOLUTE_X:
+			return get_indexed(cpu, operand, cpu->X_reg);
+		case ABSOLUTE_Y:
+			return get_indexed(cpu, operand, cpu->Y_reg);
+		case INDIRECT:
+			return ((uint16_t) bus_read(cpu->bus, operand)) | (((uint16_t) bus_read(cpu->bus, (operand&0xFF00) | ((operand + 1)&0xFF)))<<8);
+		case INDIRECT_X:
+			return get_zero_page_word(cpu, operand + cpu->X_reg);
+		case INDIRECT_Y:
+			return get_indexed(cpu, get_zero_page_word(cpu, operand), cpu->Y_reg);
+		default:
+			return operand;
+	}
 }
 
-uint8_t get_indirect_X(CPU_6502 *cpu, uint8_t index, uint8_t (*read)(uint16_t)){
-	return read(((uint16_t) read(cpu->X_reg + index)) | (((uint16_t) read(cpu->X_reg + index + 1))<<8));
+void push(CPU_6502 *cpu, uint8_t value){
+	bus_write(cpu->bus, 0x100 | cpu->SP_reg, value);
+	cpu->SP_reg -= 1;
 }
 
-uint8_t get_indirect_Y(CPU_6502 *cpu, uint8_t index, uint8_t (*read)(uint16_t)){
-	uint16_t address1;
-	uint16_t address2;
+uint8_t pop(CPU_6502 *cpu){
+	cpu->SP_reg += 1;
+	return bus_read(cpu->bus, 0x100 | cpu->SP_reg);
+}
 
-	address1 = ((uint16_t) read(index)) | (((uint16_t) read(index + 1))<<8);
-	address2 = address1 + cpu->Y_reg;
+//Update the zero and negative flags from a result
+void set_zero_negative(CPU_6502 *cpu, uint8_t value){
+	//Nothing works the flags out until something reads them
+	cpu->nz_result = value;
+}
 
-	CROSSED_PAGE = different_page(address1, address2);
+uint8_t get_status_6502(const CPU_6502 *cpu){
+	return (cpu->P_reg&~(1<<ZERO | 1<<NEGATIVE)) | (zero_flag_6502(cpu) ? 1<<ZERO : 0) | (negative_flag_6502(cpu) ? 1<<NEGATIVE : 0);
+}
 
-	return read(address2);
+void set_status_6502(CPU_6502 *cpu, uint8_t status){
+	cpu->P_reg = status;
+	//Bit 8 stands in for the negative flag, so the low byte can stay nonzero when the zero flag is clear
+	cpu->nz_result = (status&(1<<ZERO) ? 0 : 1) | (status&(1<<NEGATIVE) ? 0x100 : 0);
 }
 
-void set_absolute(CPU_6502 *cpu, uint8_t index, uint8_t (*read)(uint16_t), void (*write)(uint16_t, uint8_t), uint8_t value){
-	uint16_t address1;
-	uint16_t address2;
+void set_carry(CPU_6502 *cpu, unsigned char carry){
+	cpu->P_reg = (cpu->P_reg&~(1<<CARRY)) | (carry ? 1<<CARRY : 0);
+}
 
-	address1 = ((uint16_t) read(cpu->PC_reg + 1)) | (((uint16_t) read(cpu->PC_reg + 2))<<8);
-	address2 = address1 + index;
+void set_overflow(CPU_6502 *cpu, unsigned char overflow){
+	cpu->P_reg = (cpu->P_reg&~(1<<OVERFLOW)) | (overflow ? 1<<OVERFLOW : 0);
+}
+
+//Take a branch if the condition holds
+//Taking a branch costs one cycle, and one more if it lands on another page
+void branch(CPU_6502 *cpu, uint16_t address, unsigned char condition){
+	if(condition){
+		cpu->cycles++;
+		if(different_page(cpu->PC_reg, address)){
+			cpu->cycles++;
+		}
+		cpu->PC_reg = address;
+	}
+}
+
+/*
+ * Operations
+ *
+ * Each operation is handed the effective address of its operand.
+ * PC already points to the next instruction when an operation runs.
+ */
+
+void adc(CPU_6502 *cpu, uint16_t address){
+	uint8_t value1;
+	uint8_t prev;
 
-	CROSSED_PAGE = different_page(address1, address2);
+	value1 = bus_read(cpu->bus, address);
+	prev = cpu->A_reg;
+	//If the carry flag is set, add 1 more to result
+	if(cpu->P_reg&(1<<CARRY)){
+		value1++;
+	}
+	
+	cpu->A_reg += value1;
+	//If the decimal flag is set, correct the output
+	if(cpu->P_reg&(1<<DECIMAL)){
+		//Using double-dabble ish trick here
+		if((cpu->A_reg&0xF) > 9){
+			cpu->A_reg += 0x6;
+		}
+	}
 
-	write(address2, value);
+	//Set the carry bit accordingly
+	set_carry(cpu, cpu->A_reg < prev);
+	//Set overflow flag
+	set_overflow(cpu, ((value1&0x80) && (prev&0x80) && !(cpu->A_reg&0x80)) || (!(value1&0x80) && !(prev&0x80) && (cpu->A_reg&0x80)));
+	set_zero_negative(cpu, cpu->A_reg);
 }
 
-void set_indirect_X(CPU_6502 *cpu, uint8_t index, uint8_t (*read)(uint16_t), void (*write)(uint16_t, uint8_t), uint8_t value){
-	write(((uint16_t) read(cpu->X_reg + index)) | (((uint16_t) read(cpu->X_reg + index + 1))<<8), value);
+void and(CPU_6502 *cpu, uint16_t address){
+	cpu->A_reg &= bus_read(cpu->bus, address);
+	set_zero_negative(cpu, cpu->A_reg);
 }
 
-void set_indirect_Y(CPU_6502 *cpu, uint8_t index, uint8_t (*read)(uint16_t), void (*write)(uint16_t, uint8_t), uint8_t value){
-	uint16_t address1;
-	uint16_t address2;
+void asl_a(CPU_6502 *cpu, uint16_t address){
+	set_carry(cpu, cpu->A_reg&0x80);
+	cpu->A_reg <<= 1;
+	set_zero_negative(cpu, cpu->A_reg);
+}
 
-	address1 = ((uint16_t) read(index)) | (((uint16_t) read(index + 1))<<8);
-	address2 = address1 + cpu->Y_reg;
+void asl(CPU_6502 *cpu, uint16_t address){
+	uint8_t value1;
 
-	CROSSED_PAGE = different_page(address1, address2);
-	
-	write(address2, value);
+	value1 = bus_read(cpu->bus, address);
+	set_carry(cpu, value1&0x80);
+	value1 <<= 1;
+	bus_write(cpu->bus, address, value1);
+	set_zero_negative(cpu, value1);
 }
 
-void push(CPU_6502 *cpu, void (*write)(uint16_t, uint8_t), uint8_t value){
-	write(0x100 | cpu->SP_reg, value);
-	cpu->SP_reg -= 1;
+void bcc(CPU_6502 *cpu, uint16_t address){
+	branch(cpu, address, !(cpu->P_reg&(1<<CARRY)));
 }
 
-uint8_t pop(CPU_6502 *cpu, uint8_t (*read)(uint16_t)){
-	cpu->SP_reg += 1;
-	return read(0x100 | cpu->SP_reg);
+void bcs(CPU_6502 *cpu, uint16_t address){
+	branch(cpu, address, cpu->P_reg&(1<<CARRY));
 }
 
-//Execute a single 6502 instruction, updating the state of the CPU
-void execute_6502(CPU_6502 *cpu, uint8_t (*read)(uint16_t), void (*write)(uint16_t, uint8_t)){
-	//Various intermediate values for calculation
+void beq(CPU_6502 *cpu, uint16_t address){
+	branch(cpu, address, zero_flag_6502(cpu));
+}
+
+void bit(CPU_6502 *cpu, uint16_t address){
 	uint8_t value1;
-	uint8_t value2;
-	uint8_t value3;
-	uint16_t value_absolute;
-	uint8_t prev;
-	//The first byte at PC uniquely determines the operation
-	uint8_t opcode;
-	uint16_t address1;
 
-	opcode = read(cpu->PC_reg);
-
-	//ADC
-	if(opcode == 0x69 || opcode == 0x65 || opcode == 0x75 || opcode == 0x6D || opcode == 0x7D || opcode == 0x79 || opcode == 0x61 || opcode == 0x71){
-		if(opcode == 0x69){//Immediate
-			value1 = read(cpu->PC_reg + 1);
-			cpu->PC_reg += 2;
-			cpu->cycles += 2;
-		} else if(opcode == 0x65){//Zero page
-			value1 = read(read(cpu->PC_reg + 1));
-			cpu->PC_reg += 2;
-			cpu->cycles += 3;
-		} else if(opcode == 0x75){//Zero page X
-			value1 = read((read(cpu->PC_reg + 1) + cpu->X_reg)&0xFF);
-			cpu->PC_reg += 2;
-			cpu->cycles += 4;
-		} else if(opcode == 0x6D){//Absolute
-			value1 = get_absolute(cpu, 0, read);
-			cpu->PC_reg += 3;
-			cpu->cycles += 4;
-		} else if(opcode == 0x7D){//Absolute X
-			value1 = get_absolute(cpu, cpu->X_reg, read);
-			cpu->PC_reg += 3;
-			if(CROSSED_PAGE){
-				cpu->cycles += 5;
-			} else {
-				cpu->cycles += 4;
-			}
-		} else if(opcode == 0x79){//Absolute Y
-			value1 = get_absolute(cpu, cpu->Y_reg, read);
-			cpu->PC_reg += 3;
-			if(CROSSED_PAGE){
-				cpu->cycles += 5;
-			} else {
-				cpu->cycles += 4;
-			}
-		} else if(opcode == 0x61){//Indirect X
-			value1 = get_indirect_X(cpu, read(cpu->PC_reg + 1), read);
-			cpu->PC_reg += 2;
-			cpu->cycles += 6;
-		} else if(opcode == 0x71){//Indirect Y
-			value1 = get_indirect_Y(cpu, read(cpu->PC_reg + 1), read);
-			cpu->PC_reg += 2;
-			if(CROSSED_PAGE){
-				cpu->cycles += 6;
-			} else {
-				cpu->cycles += 5;
-			}
-		}
+	value1 = bus_read(cpu->bus, address);
 
-		prev = cpu->A_reg;
-		//If the carry flag is set, add 1 more to result
-		if(cpu->P_reg&(1<<CARRY)){
-			value1++;
-		}
-		
-		cpu->A_reg += value1;
-		//If the decimal flag is set, correct the output
-		if(cpu->P_reg&(1<<DECIMAL)){
-			//Using double-dabble ish trick here
-			if((cpu->A_reg&0xF) > 9){
-				cpu->A_reg += 0x6;
-			}
-		}
+	//Zero comes from A AND the value, but negative straight from bit 7 of the value, which goes in bit 8
+	cpu->nz_result = (value1&cpu->A_reg) | ((uint16_t) (value1&0x80))<<1;
+	set_overflow(cpu, value1&0x40);
+}
 
-		//Set the carry bit accordingly
-		if(cpu->A_reg < prev){
-			cpu->P_reg |= (1<<CARRY);
-		} else {
-			cpu->P_reg &= ~(1<<CARRY);
-		}
-		//Set overflow flag
-		if(((value1&0x80) && (prev&0x80) && !(cpu->A_reg&0x80)) || (!(value1&0x80) && !(prev&0x80) && (cpu->A_reg&0x80))){
-			cpu->P_reg |= (1<<OVERFLOW);
-		} else {
-			cpu->P_reg &= ~(1<<OVERFLOW);
-		}
-		//Set negative flag
-		if(cpu->A_reg&0x80){
-			cpu->P_reg |= (1<<NEGATIVE);
-		} else {
-			cpu->P_reg &= ~(1<<NEGATIVE);
-		}
-		//Set zero flag
-		if(!cpu->A_reg){
-			cpu->P_reg |= (1<<ZERO);
-		} else {
-			cpu->P_reg &= ~(1<<ZERO);
-		}
-	//AND
-	} else if(opcode == 0x29 || opcode == 0x25 || opcode == 0x35 || opcode == 0x2D || opcode == 0x3D || opcode == 0x39 || opcode == 0x21 || opcode == 0x31){
-		if(opcode == 0x29){//Immediate
-			value1 = read(cpu->PC_reg + 1);
-			cpu->PC_reg += 2;
-			cpu->cycles += 2;
-		} else if(opcode == 0x25){//Zero page
-			value1 = read(read(cpu->PC_reg + 1));
-			cpu->PC_reg += 2;
-			cpu->cycles += 3;
-		} else if(opcode == 0x35){//Zero page X
-			value1 = read((read(cpu->PC_reg + 1) + cpu->X_reg)&0xFF);
-			cpu->PC_reg += 2;
-			cpu->cycles += 4;
-		} else if(opcode == 0x2D){//Absolute
-			value1 = get_absolute(cpu, 0, read);
-			cpu->PC_reg += 3;
-			cpu->cycles += 4;
-		} else if(opcode == 0x3D){//Absolute X
-			value1 = get_absolute(cpu, cpu->X_reg, read);
-			cpu->PC_reg += 3;
-			if(CROSSED_PAGE){
-				cpu->cycles += 5;
-			} else {
-				cpu->cycles += 4;
-			}
-		} else if(opcode == 0x39){//Absolute Y
-			value1 = get_absolute(cpu, cpu->Y_reg, read);
-			cpu->PC_reg += 3;
-			if(CROSSED_PAGE){
-				cpu->cycles += 5;
-			} else {
-				cpu->cycles += 4;
-			}
-		} else if(opcode == 0x21){//Indirect X
-			value1 = get_indirect_X(cpu, read(cpu->PC_reg + 1), read);
-			cpu->PC_reg += 2;
-			cpu->cycles += 6;
-		} else if(opcode == 0x31){//Indirect Y
-			value1 = get_indirect_Y(cpu, read(cpu->PC_reg + 1), read);
-			cpu->PC_reg += 2;
-			if(CROSSED_PAGE){
-				cpu->cycles += 6;
-			} else {
-				cpu->cycles += 5;
-			}
-		}
+void bmi(CPU_6502 *cpu, uint16_t address){
+	branch(cpu, address, negative_flag_6502(cpu));
+}
 
-		//Perform the AND
-		cpu->A_reg &= value1;
-		
-		//Set the zero flag
-		if(!cpu->A_reg){
-			cpu->P_reg |= (1<<ZERO);
-		} else {
-			cpu->P_reg &= ~(1<<ZERO);
-		}
-		//Set the negative flag
-		if(cpu->A_reg&0x80){
-			cpu->P_reg |= (1<<NEGATIVE);
-		} else {
-			cpu->P_reg &= ~(1<<NEGATIVE);
-		}
-	//ASL
-	} else if(opcode == 0x0A || opcode == 0x06 || opcode == 0x16 || opcode == 0x0E || opcode == 0x1E){
-		if(opcode == 0x0A){//Accumulator
-			value1 = cpu->A_reg;
-			cpu->cycles += 2;
-		} else if(opcode == 0x06){//Zero page
-			value1 = read(read(cpu->PC_reg + 1));
-			cpu->cycles += 5;
-		} else if(opcode == 0x16){//Zero page X
-			value1 = read((read(cpu->PC_reg + 1) + cpu->X_reg)&0xFF);
-			cpu->cycles += 6;
-		} else if(opcode == 0x0E){//Absolute
-			value1 = get_absolute(cpu, 0, read);
-			cpu->cycles += 6;
-		} else if(opcode == 0x1E){//Absolute X
-			value1 = get_absolute(cpu, cpu->X_reg, read);
-			cpu->cycles += 7;
-		}
+void bne(CPU_6502 *cpu, uint16_t address){
+	branch(cpu, address, !zero_flag_6502(cpu));
+}
 
-		//Set the carry flag
-		if(value1&0x80){
-			cpu->P_reg |= (1<<CARRY);
-		} else {
-			cpu->P_reg &= ~(1<<CARRY);
-		}
+void bpl(CPU_6502 *cpu, uint16_t address){
+	branch(cpu, address, !negative_flag_6502(cpu));
+}
 
-		//Perform the shift
-		value1 <<= 1;
-
-		if(opcode == 0x0A){//Accumulator
-			cpu->A_reg = value1;
-			cpu->PC_reg += 1;
-		} else if(opcode == 0x06){//Zero page
-			write(read(cpu->PC_reg + 1), value1);
-			cpu->PC_reg += 2;
-		} else if(opcode == 0x16){//Zero page X
-			write((read(cpu->PC_reg + 1) + cpu->X_reg)&0xFF, value1);
-			cpu->PC_reg += 2;
-		} else if(opcode == 0x0E){//Absolute
-			set_absolute(cpu, 0, read, write, value1);
-			cpu->PC_reg += 3;
-		} else if(opcode == 0x1E){//Absolute X
-			set_absolute(cpu, cpu->X_reg, read, write, value1);
-			cpu->PC_reg += 3;
-		}
+//Break (forced interrupt)
+void brk(CPU_6502 *cpu, uint16_t address){
+	//Set the break flag
+	cpu->P_reg |= 1<<BREAK;
+	//BRK skips a padding byte after the opcode
+	cpu->PC_reg += 1;
+	push(cpu, (cpu->PC_reg&0xFF00)>>8);
+	push(cpu, cpu->PC_reg&0xFF);
+	push(cpu, get_status_6502(cpu));
+	cpu->P_reg |= 1<<INTERRUPT;
+	cpu->PC_reg = get_word(cpu, 0xFFFE);
+}
 
-		//Set the zero flag
-		if(!value1){
-			cpu->P_reg |= 1<<ZERO;
-		} else {
-			cpu->P_reg &= ~(1<<ZERO);
-		}
+void bvc(CPU_6502 *cpu, uint16_t address){
+	branch(cpu, address, !(cpu->P_reg&(1<<OVERFLOW)));
+}
 
-		//Set the negative flag
-		if(value1&0x80){
-			cpu->P_reg |= 1<<NEGATIVE;
-		} else {
-			cpu->P_reg &= ~(1<<NEGATIVE);
-		}
-	//BCC
-	} else if(opcode == 0x90){//Branch carry clear
-		cpu->cycles += 2;
-		
-		if(!(cpu->P_reg&(1<<CARRY))){//If the carry is clear
-			cpu->cycles++;
-			value1 = read(cpu->PC_reg + 1);
-			if(value1&0x80){//If it is a negative jump
-				address1 = cpu->PC_reg - (((uint16_t) ((~value1) - 1))&0xFF);
-				if(different_page(cpu->PC_reg, address1)){
-					cpu->cycles++;
-				}
-				cpu->PC_reg = address1;
-			} else {//If it is a positive jump
-				address1 = cpu->PC_reg + value1 + 2;
-				if(different_page(cpu->PC_reg, address1)){
-					cpu->cycles++;
-				}
-				cpu->PC_reg = address1;
-			}
-		} else {
-			cpu->PC_reg += 2;
-		}
-	//BCS
-	} else if(opcode == 0xB0){//Branch carry set
-		cpu->cycles += 2;
+void bvs(CPU_6502 *cpu, uint16_t address){
+	branch(cpu, address, cpu->P_reg&(1<<OVERFLOW));
+}
 
-		if(cpu->P_reg&(1<<CARRY)){//If the carry is set
-			cpu->cycles++;
-			value1 = read(cpu->PC_reg + 1);
-			if(value1&0x80){//If it is a negative jump
-				address1 = cpu->PC_reg - (((uint16_t) ((~value1) - 1))&0xFF);
-				if(different_page(cpu->PC_reg, address1)){
-					cpu->cycles++;
-				}
-				cpu->PC_reg = address1;
-			} else {//If it is a positive jump
-				address1 = cpu->PC_reg + value1 + 2;
-				if(different_page(cpu->PC_reg, address1)){
-					cpu->cycles++;
-				}
-				cpu->PC_reg = address1;
-			}
-		} else {
-			cpu->PC_reg += 2;
-		}
-	//BEQ
-	} else if(opcode == 0xF0){//Branch equals
-		cpu->cycles += 2;
+void clc(CPU_6502 *cpu, uint16_t address){
+	cpu->P_reg &= ~(1<<CARRY);
+}
 
-		if(cpu->P_reg&(1<<ZERO)){//If the zero flag is set
-			cpu->cycles++;
-			value1 = read(cpu->PC_reg + 1);
-			if(value1&0x80){//If it is a negative jump
-				address1 = cpu->PC_reg - (((uint16_t) ((~value1) - 1))&0xFF);
-				if(different_page(cpu->PC_reg, address1)){
-					cpu->cycles++;
-				}
-				cpu->PC_reg = address1;
-			} else {//If it is a postive jump
-				address1 = cpu->PC_reg + value1 + 2;
-				if(different_page(cpu->PC_reg, address1)){
-					cpu->cycles++;
-				}
-				cpu->PC_reg = address1;
-			}
-		} else {
-			cpu->PC_reg += 2;
-		}
-	//BIT
-	} else if(opcode == 0x24 || opcode == 0x2C){
-		if(opcode == 0x24){//Zero page
-			value1 = read(read(cpu->PC_reg + 1));
-			cpu->PC_reg += 2;
-			cpu->cycles += 3;
-		} else if(opcode == 0x2C){//Absolute
-			value1 = get_absolute(cpu, 0, read);
-			cpu->PC_reg += 3;
-			cpu->cycles += 4;
-		}
+void cld(CPU_6502 *cpu, uint16_t address){
+	cpu->P_reg &= ~(1<<DECIMAL);
+}
 
-		//Set the zero flag
-		if(!(value1&cpu->A_reg)){
-			cpu->P_reg |= 1<<ZERO;
-		} else {
-			cpu->P_reg &= ~(1<<ZERO);
-		}
+void cli(CPU_6502 *cpu, uint16_t address){
+	cpu->P_reg &= ~(1<<INTERRUPT);
+}
 
-		//Set the negative flag
-		if(value1&0x80){
-			cpu->P_reg |= 1<<NEGATIVE;
-		} else {
-			cpu->P_reg &= ~(1<<NEGATIVE);
-		}
+void clv(CPU_6502 *cpu, uint16_t address){
+	cpu->P_reg &= ~(1<<OVERFLOW);
+}
 
-		//Set the overflow flag
-		if(value1&0x40){
-			cpu->P_reg |= 1<<OVERFLOW;
-		} else {
-			cpu->P_reg &= ~(1<<OVERFLOW);
-		}
-	//BMI
-	} else if(opcode == 0x30){//Branch minus
-		cpu->cycles += 2;
+//Shared by CMP, CPX and CPY
+void compare(CPU_6502 *cpu, uint8_t reg, uint8_t value1){
+	set_zero_negative(cpu, reg - value1);
+	set_carry(cpu, reg >= value1);
+}
 
-		if(cpu->P_reg&(1<<NEGATIVE)){//Test the negative flag
-			cpu->cycles++;
-			value1 = read(cpu->PC_reg + 1);
-			if(value1&0x80){//If it is a negative jump
-				address1 = cpu->PC_reg - (((uint16_t) ((~value1) - 1))&0xFF);
-				if(different_page(cpu->PC_reg, address1)){
-					cpu->cycles++;
-				}
-				cpu->PC_reg = address1;
-			} else {//If it is a positive jump
-				address1 = cpu->PC_reg + value1 + 2;
-				if(different_page(cpu->PC_reg, address1)){
-					cpu->cycles++;
-				}
-				cpu->PC_reg = address1;
-			}
-		} else {
-			cpu->PC_reg += 2;
-		}
-	//BNE
-	} else if(opcode == 0xD0){//Branch not equal
-		cpu->cycles += 2;
+void cmp(CPU_6502 *cpu, uint16_t address){
+	compare(cpu, cpu->A_reg, bus_read(cpu->bus, address));
+}
 
-		if(!(cpu->P_reg&(1<<ZERO))){
-			cpu->cycles++;
-			value1 = read(cpu->PC_reg + 1);
-			if(value1&0x80){//If it is a negative jump
-				address1 = cpu->PC_reg - (((uint16_t) ((~value1) - 1))&0xFF);
-				if(different_page(cpu->PC_reg, address1)){
-					cpu->cycles++;
-				}
-				cpu->PC_reg = address1;
-			} else {//If it is a positive jump
-				address1 = cpu->PC_reg + value1 + 2;
-				if(different_page(cpu->PC_reg, address1)){
-					cpu->cycles++;
-				}
-				cpu->PC_reg = address1;
-			}
-		} else {
-			cpu->PC_reg += 2;
-		}
-	//BPL
-	} else if(opcode == 0x10){//Branch positive
-		cpu->cycles += 2;
+void cpx(CPU_6502 *cpu, uint16_t address){
+	compare(cpu, cpu->X_reg, bus_read(cpu->bus, address));
+}
 
-		if(!(cpu->P_reg&(1<<NEGATIVE))){
-			cpu->cycles++;
-			value1 = read(cpu->PC_reg + 1);
-			if(value1&0x80){//If it is a negative jump
-				address1 = cpu->PC_reg - (((uint16_t) ((~value1) - 1))&0xFF);
-				if(different_page(cpu->PC_reg, address1)){
-					cpu->cycles++;
-				}
-				cpu->PC_reg = address1;
-			} else {//If it is a positive jump
-				address1 = cpu->PC_reg + value1 + 2;
-				if(different_page(cpu->PC_reg, address1)){
-					cpu->cycles++;
-				}
-				cpu->PC_reg = address1;
-			}
-		} else {
-			cpu->PC_reg += 2;
-		}
-	//BRK
-	} else if(opcode == 0x00){//Break (forced interrupt)
-		//Set the break flag
-		cpu->P_reg |= 1<<BREAK;
-		cpu->PC_reg += 2;
-		push(cpu, write, (cpu->PC_reg&0xFF00)>>8);
-		push(cpu, write, cpu->PC_reg&0xFF);
-		push(cpu, write, cpu->P_reg);
-		cpu->P_reg |= 1<<INTERRUPT;
-		cpu->PC_reg = (((uint16_t) read(0xFFFF))<<8) | read(0xFFFE);
-		cpu->cycles += 7;
-	//BVC
-	} else if(opcode == 0x50){//Branch overflow clear
-		cpu->cycles += 2;
-
-		if(!(cpu->P_reg&(1<<OVERFLOW))){
-			cpu->cycles++;
-			value1 = read(cpu->PC_reg + 1);
-			if(value1&0x80){//If it is a negative jump
-				address1 = cpu->PC_reg - (((uint16_t) ((~value1) - 1))&0xFF);
-				if(different_page(cpu->PC_reg, address1)){
-					cpu->cycles++;
-				}
-				cpu->PC_reg = address1;
-			} else {//If it is a positive jump
-				address1 = cpu->PC_reg + value1 + 2;
-				if(different_page(cpu->PC_reg, address1)){
-					cpu->cycles++;
-				}
-				cpu->PC_reg = address1;
-			}
-		} else {
-			cpu->PC_reg += 2;
-		}
-	//BVS
-	} else if(opcode == 0x70){//Branch overflow set
-		cpu->cycles += 2;
+void cpy(CPU_6502 *cpu, uint16_t address){
+	compare(cpu, cpu->Y_reg, bus_read(cpu->bus, address));
+}
 
-		if(cpu->P_reg&(1<<OVERFLOW)){
-			cpu->cycles++;
-			value1 = read(cpu->PC_reg + 1);
-			if(value1&0x80){//If it is a negative jump
-				address1 = cpu->PC_reg - (((uint16_t) ((~value1) - 1))&0xFF);
-				if(different_page(cpu->PC_reg, address1)){
-					cpu->cycles++;
-				}
-				cpu->PC_reg = address1;
-			} else {//If it is a positive jump
-				address1 = cpu->PC_reg + value1 + 2;
-				if(different_page(cpu->PC_reg, address1)){
-					cpu->cycles++;
-				}
-				cpu->PC_reg = address1;
-			}
-		} else {
-			cpu->PC_reg += 2;
-		}
-	//CLC
-	} else if(opcode == 0x18){//Clear carry flag
-		cpu->P_reg &= ~(1<<CARRY);
-		cpu->PC_reg += 1;
-		cpu->cycles += 2;
-	//CLD
-	} else if(opcode == 0xD8){//Clear decimal flag
-		cpu->P_reg &= ~(1<<DECIMAL);
-		cpu->PC_reg += 1;
-		cpu->cycles += 2;
-	//CLI
-	} else if(opcode == 0x58){//Clear interrupt flag
-		cpu->P_reg &= ~(1<<INTERRUPT);
-		cpu->PC_reg += 1;
-		cpu->cycles += 2;
-	//CLV
-	} else if(opcode == 0xB8){//Clear overflow flag
-		cpu->P_reg &= ~(1<<OVERFLOW);
-		cpu->PC_reg += 1;
-		cpu->cycles += 2;
-	//CMP
-	} else if(opcode == 0xC9 || opcode == 0xC5 || opcode == 0xD5 || opcode == 0xCD || opcode == 0xDD || opcode == 0xD9 || opcode == 0xC1 || opcode == 0xD1){
-		if(opcode == 0xC9){//Immediate
-			value1 = read(cpu->PC_reg + 1);
-			cpu->PC_reg += 2;
-			cpu->cycles += 2;
-		} else if(opcode == 0xC5){//Zero page
-			value1 = read(read(cpu->PC_reg + 1));
-			cpu->PC_reg += 2;
-			cpu->cycles += 3;
-		} else if(opcode == 0xD5){//Zero page X
-			value1 = read((read(cpu->PC_reg + 1) + cpu->X_reg)&0xFF);
-			cpu->PC_reg += 2;
-			cpu->cycles += 4;
-		} else if(opcode == 0xCD){//Absolute
-			value1 = get_absolute(cpu, 0, read);
-			cpu->PC_reg += 3;
-			cpu->cycles += 4;
-		} else if(opcode == 0xDD){//Absolute X
-			value1 = get_absolute(cpu, cpu->X_reg, read);
-			cpu->PC_reg += 3;
-			if(CROSSED_PAGE){
-				cpu->cycles += 5;
-			} else {
-				cpu->cycles += 4;
-			}
-		} else if(opcode == 0xD9){//Absolute Y
-			value1 = get_absolute(cpu, cpu->Y_reg, read);
-			cpu->PC_reg += 3;
-			if(CROSSED_PAGE){
-				cpu->cycles += 5;
-			} else {
-				cpu->cycles += 4;
-			}
-		} else if(opcode == 0xC1){//Indirect X
-			value1 = get_indirect_X(cpu, read(cpu->PC_reg + 1), read);
-			cpu->PC_reg += 2;
-			cpu->cycles += 6;
-		} else if(opcode == 0xD1){//Indirect Y
-			value1 = get_indirect_Y(cpu, read(cpu->PC_reg + 1), read);
-			cpu->PC_reg += 2;
-			if(CROSSED_PAGE){
-				cpu->cycles += 6;
-			} else {
-				cpu->cycles += 5;
-			}
-		}
+void dec(CPU_6502 *cpu, uint16_t address){
+	uint8_t value1;
 
-		value2 = cpu->A_reg - value1;
-		
-		//Set the zero flag
-		if(!value2){
-			cpu->P_reg |= 1<<ZERO;
-		} else {
-			cpu->P_reg &= ~(1<<ZERO);
-		}
+	value1 = bus_read(cpu->bus, address) - 1;
+	bus_write(cpu->bus, address, value1);
+	set_zero_negative(cpu, value1);
+}
 
-		//Set the negative flag
-		if(value2&0x80){
-			cpu->P_reg |= 1<<NEGATIVE;
-		} else {
-			cpu->P_reg &= ~(1<<NEGATIVE);
-		}
+void dex(CPU_6502 *cpu, uint16_t address){
+	cpu->X_reg--;
+	set_zero_negative(cpu, cpu->X_reg);
+}
 
-		//Set the carry flag
-		if(cpu->A_reg >= value1){
-			cpu->P_reg |= 1<<CARRY;
-		} else {
-			cpu->P_reg &= ~(1<<CARRY);
-		}
-	//CPX
-	} else if(opcode == 0xE0 || opcode == 0xE4 || opcode == 0xEC){
-		if(opcode == 0xE0){//Immediate
-			value1 = read(cpu->PC_reg + 1);
-			cpu->PC_reg += 2;
-			cpu->cycles += 2;
-		} else if(opcode == 0xE4){//Zero Page
-			value1 = read(read(cpu->PC_reg + 1));
-			cpu->PC_reg += 2;
-			cpu->cycles += 3;
-		} else if(opcode == 0xEC){//Absolute
-			value1 = get_absolute(cpu, 0, read);
-			cpu->PC_reg += 3;
-			cpu->cycles += 4;
-		}
+void dey(CPU_6502 *cpu, uint16_t address){
+	cpu->Y_reg--;
+	set_zero_negative(cpu, cpu->Y_reg);
+}
 
-		value2 = cpu->X_reg - value1;
+void eor(CPU_6502 *cpu, uint16_t address){
+	cpu->A_reg ^= bus_read(cpu->bus, address);
+	set_zero_negative(cpu, cpu->A_reg);
+}
 
-		//Set the zero flag
-		if(!value2){
-			cpu->P_reg |= 1<<ZERO;
-		} else {
-			cpu->P_reg &= ~(1<<ZERO);
-		}
+void inc(CPU_6502 *cpu, uint16_t address){
+	uint8_t value1;
 
-		//Set the negative flag
-		if(value2&0x80){
-			cpu->P_reg |= 1<<NEGATIVE;
-		} else {
-			cpu->P_reg &= ~(1<<NEGATIVE);
-		}
+	value1 = bus_read(cpu->bus, address) + 1;
+	bus_write(cpu->bus, address, value1);
+	set_zero_negative(cpu, value1);
+}
 
-		//Set the carry flag
-		if(cpu->X_reg >= value1){
-			cpu->P_reg |= 1<<CARRY;
-		} else {
-			cpu->P_reg &= ~(1<<CARRY);
-		}
-	//CPY
-	} else if(opcode == 0xC0 || opcode == 0xC4 || opcode == 0xCC){
-		if(opcode == 0xC0){//Immediate
-			value1 = read(cpu->PC_reg + 1);
-			cpu->PC_reg += 2;
-			cpu->cycles += 2;
-		} else if(opcode == 0xC4){//Zero Page
-			value1 = read(read(cpu->PC_reg + 1));
-			cpu->PC_reg += 2;
-			cpu->cycles += 3;
-		} else if(opcode == 0xCC){//Absolute
-			value1 = get_absolute(cpu, 0, read);
-			cpu->PC_reg += 3;
-			cpu->cycles += 4;
-		}
+void inx(CPU_6502 *cpu, uint16_t address){
+	cpu->X_reg++;
+	set_zero_negative(cpu, cpu->X_reg);
+}
 
-		value2 = cpu->Y_reg - value1;
+void iny(CPU_6502 *cpu, uint16_t address){
+	cpu->Y_reg++;
+	set_zero_negative(cpu, cpu->Y_reg);
+}
 
-		//Set the zero flag
-		if(!value2){
-			cpu->P_reg |= 1<<ZERO;
-		} else {
-			cpu->P_reg &= ~(1<<ZERO);
-		}
+void jmp(CPU_6502 *cpu, uint16_t address){
+	cpu->PC_reg = address;
+}
 
-		//Set the negative flag
-		if(value2&0x80){
-			cpu->P_reg |= 1<<NEGATIVE;
-		} else {
-			cpu->P_reg &= ~(1<<NEGATIVE);
-		}
+void jsr(CPU_6502 *cpu, uint16_t address){
+	//Push the address of the last byte of the JSR instruction
+	push(cpu, (cpu->PC_reg - 1)&0xFF);
+	push(cpu, (cpu->PC_reg - 1)>>8);
+	cpu->PC_reg = address;
+}
 
-		//Set the carry flag
-		if(cpu->Y_reg >= value1){
-			cpu->P_reg |= 1<<CARRY;
-		} else {
-			cpu->P_reg &= ~(1<<CARRY);
-		}
-	//DEC
-	} else if(opcode == 0xC6 || opcode == 0xD6 || opcode == 0xCE || opcode == 0xDE){
-		if(opcode == 0xC6){//Zero page
-			value2 = read(cpu->PC_reg + 1);
-			value1 = read(value2);
-			value1--;
-			write(value2, value1);
-			cpu->PC_reg += 2;
-			cpu->cycles += 5;
-		} else if(opcode == 0xD6){//Zero page X
-			value2 = read(cpu->PC_reg + 1);
-			value1 = read((value2 + cpu->X_reg)&0xFF);
-			value1--;
-			write((value2 + cpu->X_reg)&0xFF, value1);
-			cpu->PC_reg += 2;
-			cpu->cycles += 6;
-		} else if(opcode == 0xCE){//Absolute
-			value1 = get_absolute(cpu, 0, read) - 1;
-			set_absolute(cpu, 0, read, write, value1);
-			cpu->PC_reg += 3;
-			cpu->cycles += 6;
-		} else if(opcode == 0xDE){//Absolute X
-			value1 = get_absolute(cpu, cpu->X_reg, read) - 1;
-			set_absolute(cpu, cpu->X_reg, read, write, value1);
-			cpu->PC_reg += 3;
-			cpu->cycles += 7;
-		}
+void lda(CPU_6502 *cpu, uint16_t address){
+	cpu->A_reg = bus_read(cpu->bus, address);
+	set_zero_negative(cpu, cpu->A_reg);
+}
 
-		//Set the zero flag
-		if(!value1){
-			cpu->P_reg |= 1<<ZERO;
-		} else {
-			cpu->P_reg &= ~(1<<ZERO);
-		}
+void ldx(CPU_6502 *cpu, uint16_t address){
+	cpu->X_reg = bus_read(cpu->bus, address);
+	set_zero_negative(cpu, cpu->X_reg);
+}
 
-		//Set the negative flag
-		if(value1&0x80){
-			cpu->P_reg |= 1<<NEGATIVE;
-		} else {
-			cpu->P_reg &= ~(1<<NEGATIVE);
-		}
-	//DEX
-	} else if(opcode == 0xCA){
-		cpu->X_reg--;
-		cpu->PC_reg += 1;
-		cpu->cycles += 2;
-
-		//Set the zero flag
-		if(!cpu->X_reg){
-			cpu->P_reg |= 1<<ZERO;
-		} else {
-			cpu->P_reg &= ~(1<<ZERO);
-		}
+void ldy(CPU_6502 *cpu, uint16_t address){
+	cpu->Y_reg = bus_read(cpu->bus, address);
+	set_zero_negative(cpu, cpu->Y_reg);
+}
 
-		//Set the negative flag
-		if(cpu->X_reg&0x80){
-			cpu->P_reg |= 1<<NEGATIVE;
-		} else {
-			cpu->P_reg &= ~(1<<NEGATIVE);
-		}
-	//DEY
-	} else if(opcode == 0x88){
-		cpu->Y_reg--;
-		cpu->PC_reg += 1;
-		cpu->cycles += 2;
-
-		//Set the zero flag
-		if(!cpu->Y_reg){
-			cpu->P_reg |= 1<<ZERO;
-		} else {
-			cpu->P_reg &= ~(1<<ZERO);
-		}
+void lsr_a(CPU_6502 *cpu, uint16_t address){
+	set_carry(cpu, cpu->A_reg&0x1);
+	cpu->A_reg >>= 1;
+	set_zero_negative(cpu, cpu->A_reg);
+}
 
-		//Set the negative flag
-		if(cpu->Y_reg&0x80){
-			cpu->P_reg |= 1<<NEGATIVE;
-		} else {
-			cpu->P_reg &= ~(1<<NEGATIVE);
-		}
-	//EOR
-	} else if(opcode == 0x49 || opcode == 0x45 || opcode == 0x55 || opcode == 0x4D || opcode == 0x5D || opcode == 0x59 || opcode == 0x41 || opcode == 0x51){
-		if(opcode == 0x49){//Immediate
-			value1 = read(cpu->PC_reg + 1);
-			cpu->PC_reg += 2;
-			cpu->cycles += 2;
-		} else if(opcode == 0x45){//Zero page
-			value1 = read(read(cpu->PC_reg + 1));
-			cpu->PC_reg += 2;
-			cpu->cycles += 3;
-		} else if(opcode == 0x55){//Zero page X
-			value1 = read((read(cpu->PC_reg + 1) + cpu->X_reg)&0xFF);
-			cpu->PC_reg += 2;
-			cpu->cycles += 4;
-		} else if(opcode == 0x4D){//Absolute
-			value1 = get_absolute(cpu, 0, read);
-			cpu->PC_reg += 3;
-			cpu->cycles += 4;
-		} else if(opcode == 0x5D){//Absolute X
-			value1 = get_absolute(cpu, cpu->X_reg, read);
-			cpu->PC_reg += 3;
-			if(CROSSED_PAGE){
-				cpu->cycles += 5;
-			} else {
-				cpu->cycles += 4;
-			}
-		} else if(opcode == 0x59){//Absolute Y
-			value1 = get_absolute(cpu, cpu->Y_reg, read);
-			cpu->PC_reg += 3;
-			if(CROSSED_PAGE){
-				cpu->cycles += 5;
-			} else {
-				cpu->cycles += 4;
-			}
-		} else if(opcode == 0x41){//Indirect X
-			value1 = get_indirect_X(cpu, read(cpu->PC_reg + 1), read);
-			cpu->PC_reg += 2;
-			cpu->cycles += 6;
-		} else if(opcode == 0x51){//Indirect Y
-			value1 = get_indirect_Y(cpu, read(cpu->PC_reg + 1), read);
-			cpu->PC_reg += 2;
-			if(CROSSED_PAGE){
-				cpu->cycles += 6;
-			} else {
-				cpu->cycles += 5;
-			}
-		}
+void lsr(CPU_6502 *cpu, uint16_t address){
+	uint8_t value1;
 
-		cpu->A_reg ^= value1;
+	value1 = bus_read(cpu->bus, address);
+	set_carry(cpu, value1&0x1);
+	value1 >>= 1;
+	bus_write(cpu->bus, address, value1);
+	set_zero_negative(cpu, value1);
+}
 
-		//Set the zero flag
-		if(!cpu->A_reg){
-			cpu->P_reg |= 1<<ZERO;
-		} else {
-			cpu->P_reg &= ~(1<<ZERO);
-		}
+void nop(CPU_6502 *cpu, uint16_t address){
+}
 
-		//Set the negative flag
-		if(cpu->A_reg&0x80){
-			cpu->P_reg |= 1<<NEGATIVE;
-		} else {
-			cpu->P_reg &= ~(1<<NEGATIVE);
-		}
-	//INC
-	} else if(opcode == 0xE6 || opcode == 0xF6 || opcode == 0xEE || opcode == 0xFE){
-		if(opcode == 0xE6){//Zero page
-			value2 = read(cpu->PC_reg + 1);
-			value1 = read(value2);
-			value1++;
-			write(value2, value1);
-			cpu->PC_reg += 2;
-			cpu->cycles += 5;
-		} else if(opcode == 0xF6){//Zero page X
-			value2 = read(cpu->PC_reg + 1);
-			value1 = read((value2 + cpu->X_reg)&0xFF);
-			value1++;
-			write((value2 + cpu->X_reg)&0xFF, value1);
-			cpu->PC_reg += 2;
-			cpu->cycles += 6;
-		} else if(opcode == 0xEE){//Absolute
-			value1 = get_absolute(cpu, 0, read) + 1;
-			set_absolute(cpu, 0, read, write, value1);
-			cpu->PC_reg += 3;
-			cpu->cycles += 6;
-		} else if(opcode == 0xFE){//Absolute X
-			value1 = get_absolute(cpu, cpu->X_reg, read) + 1;
-			set_absolute(cpu, cpu->X_reg, read, write, value1);
-			cpu->PC_reg += 3;
-			cpu->cycles += 7;
-		}
+void ora(CPU_6502 *cpu, uint16_t address){
+	cpu->A_reg |= bus_read(cpu->bus, address);
+	set_zero_negative(cpu, cpu->A_reg);
+}
 
-		//Set the zero flag
-		if(!value1){
-			cpu->P_reg |= 1<<ZERO;
-		} else {
-			cpu->P_reg &= ~(1<<ZERO);
-		}
+void pha(CPU_6502 *cpu, uint16_t address){
+	push(cpu, cpu->A_reg);
+}
 
-		//Set the negative flag
-		if(value1&0x80){
-			cpu->P_reg |= 1<<NEGATIVE;
-		} else {
-			cpu->P_reg &= ~(1<<NEGATIVE);
-		}
-	//INX
-	} else if(opcode == 0xE8){
-		cpu->X_reg++;
-		cpu->PC_reg += 1;
-		cpu->cycles += 2;
-
-		//Set the zero flag
-		if(!cpu->X_reg){
-			cpu->P_reg |= 1<<ZERO;
-		} else {
-			cpu->P_reg &= ~(1<<ZERO);
-		}
+//PHP (sucks)
+void php(CPU_6502 *cpu, uint16_t address){
+	push(cpu, get_status_6502(cpu));
+}
 
-		//Set the negative flag
-		if(cpu->X_reg&0x80){
-			cpu->P_reg |= 1<<NEGATIVE;
-		} else {
-			cpu->P_reg &= ~(1<<NEGATIVE);
-		}
-	//INY
-	} else if(opcode == 0xC8){
-		cpu->Y_reg++;
-		cpu->PC_reg += 1;
-		cpu->cycles += 2;
-
-		//Set the zero flag
-		if(!cpu->Y_reg){
-			cpu->P_reg |= 1<<ZERO;
-		} else {
-			cpu->P_reg &= ~(1<<ZERO);
-		}
+void pla(CPU_6502 *cpu, uint16_t address){
+	cpu->A_reg = pop(cpu);
+	set_zero_negative(cpu, cpu->A_reg);
+}
 
-		//Set the negative flag
-		if(cpu->Y_reg&0x80){
-			cpu->P_reg |= 1<<NEGATIVE;
-		} else {
-			cpu->P_reg &= ~(1<<NEGATIVE);
-		}
-	//JMP
-	} else if(opcode == 0x4C || opcode == 0x6C){
-		if(opcode == 0x4C){//Absolute
-			cpu->PC_reg = ((uint16_t) read(cpu->PC_reg + 1)) | (((uint16_t) read(cpu->PC_reg + 2))<<8);
-			cpu->cycles += 3;
-		} else if(opcode == 0x6C){//Indirect
-			value_absolute = ((uint16_t) read(cpu->PC_reg + 1)) | (((uint16_t) read(cpu->PC_reg + 2))<<8);
-			value1 = read(value_absolute);
-			value2 = read((value_absolute&0xFF00) | ((value_absolute + 1)&0xFF));
-			cpu->PC_reg = (((uint16_t) value2)<<8) | value1;
-			cpu->cycles += 5;
-		}
-	//JSR
-	} else if(opcode == 0x20){
-		push(cpu, write, (cpu->PC_reg + 2)&0xFF);
-		push(cpu, write, (cpu->PC_reg + 2)>>8);
-		cpu->PC_reg = ((uint16_t) read(cpu->PC_reg + 1)) | (((uint16_t) read(cpu->PC_reg + 2))<<8);
-		cpu->cycles += 6;
-	//LDA
-	} else if(opcode == 0xA9 || opcode == 0xA5 || opcode == 0xB5 || opcode == 0xAD || opcode == 0xBD || opcode == 0xB9 || opcode == 0xA1 || opcode == 0xB1){
-		if(opcode == 0xA9){//Immediate
-			cpu->A_reg = read(cpu->PC_reg + 1);
-			cpu->PC_reg += 2;
-			cpu->cycles += 2;
-		} else if(opcode == 0xA5){//Zero page
-			cpu->A_reg = read(read(cpu->PC_reg + 1));
-			cpu->PC_reg += 2;
-			cpu->cycles += 3;
-		} else if(opcode == 0xB5){//Zero page X
-			cpu->A_reg = read((read(cpu->PC_reg + 1) + cpu->X_reg)&0xFF);
-			cpu->PC_reg += 2;
-			cpu->cycles += 4;
-		} else if(opcode == 0xAD){//Absolute
-			cpu->A_reg = get_absolute(cpu, 0, read);
-			cpu->PC_reg += 3;
-			cpu->cycles += 4;
-		} else if(opcode == 0xBD){//Absolute X
-			cpu->A_reg = get_absolute(cpu, cpu->X_reg, read);
-			cpu->PC_reg += 3;
-			if(CROSSED_PAGE){
-				cpu->cycles += 5;
-			} else {
-				cpu->cycles += 4;
-			}
-		} else if(opcode == 0xB9){//Absolute Y
-			cpu->A_reg = get_absolute(cpu, cpu->Y_reg, read);
-			cpu->PC_reg += 3;
-			if(CROSSED_PAGE){
-				cpu->cycles += 5;
-			} else {
-				cpu->cycles += 4;
-			}
-		} else if(opcode == 0xA1){//Indirect X
-			cpu->A_reg = get_indirect_X(cpu, read(cpu->PC_reg + 1), read);
-			cpu->PC_reg += 2;
-			cpu->cycles += 6;
-		} else if(opcode == 0xB1){//Indirect Y
-			cpu->A_reg = get_indirect_Y(cpu, read(cpu->PC_reg + 1), read);
-			cpu->PC_reg += 2;
-			if(CROSSED_PAGE){
-				cpu->cycles += 6;
-			} else {
-				cpu->cycles += 5;
-			}
-		}
+void plp(CPU_6502 *cpu, uint16_t address){
+	set_status_6502(cpu, pop(cpu));
+}
 
-		//Set the zero flag
-		if(!cpu->A_reg){
-			cpu->P_reg |= 1<<ZERO;
-		} else {
-			cpu->P_reg &= ~(1<<ZERO);
-		}
+void rol_a(CPU_6502 *cpu, uint16_t address){
+	uint8_t value1;
 
-		//Set the negative flag
-		if(cpu->A_reg&0x80){
-			cpu->P_reg |= 1<<NEGATIVE;
-		} else {
-			cpu->P_reg &= ~(1<<NEGATIVE);
-		}
-	//LDX
-	} else if(opcode == 0xA2 || opcode == 0xA6 || opcode == 0xB6 || opcode == 0xAE || opcode == 0xBE){
-		if(opcode == 0xA2){//Immediate
-			cpu->X_reg = read(cpu->PC_reg + 1);
-			cpu->PC_reg += 2;
-			cpu->cycles += 2;
-		} else if(opcode == 0xA6){//Zero page
-			cpu->X_reg = read(read(cpu->PC_reg + 1));
-			cpu->PC_reg += 2;
-			cpu->cycles += 3;
-		} else if(opcode == 0xB6){//Zero page Y
-			cpu->X_reg = read((read(cpu->PC_reg + 1) + cpu->Y_reg)&0xFF);
-			cpu->PC_reg += 2;
-			cpu->cycles += 4;
-		} else if(opcode == 0xAE){//Absolute
-			cpu->X_reg = get_absolute(cpu, 0, read);
-			cpu->PC_reg += 3;
-			cpu->cycles += 4;
-		} else if(opcode == 0xBE){//Absolute Y
-			cpu->X_reg = get_absolute(cpu, cpu->Y_reg, read);
-			cpu->PC_reg += 3;
-			if(CROSSED_PAGE){
-				cpu->cycles += 5;
-			} else {
-				cpu->cycles += 4;
-			}
-		}
+	value1 = cpu->A_reg;
+	cpu->A_reg = (value1<<1) | (cpu->P_reg&(1<<CARRY) ? 1 : 0);
+	set_carry(cpu, value1&0x80);
+	set_zero_negative(cpu, cpu->A_reg);
+}
 
-		//Set the zero flag
-		if(!cpu->X_reg){
-			cpu->P_reg |= 1<<ZERO;
-		} else {
-			cpu->P_reg &= ~(1<<ZERO);
-		}
+void rol(CPU_6502 *cpu, uint16_t address){
+	uint8_t value1;
+	uint8_t value2;
 
-		//Set the negative flag
-		if(cpu->X_reg&0x80){
-			cpu->P_reg |= 1<<NEGATIVE;
-		} else {
-			cpu->P_reg &= ~(1<<NEGATIVE);
-		}
-	//LDY
-	} else if(opcode == 0xA0 || opcode == 0xA4 || opcode == 0xB4 || opcode == 0xAC || opcode == 0xBC){
-		if(opcode == 0xA0){//Immediate
-			cpu->Y_reg = read(cpu->PC_reg + 1);
-			cpu->PC_reg += 2;
-			cpu->cycles += 2;
-		} else if(opcode == 0xA4){//Zero page
-			cpu->Y_reg = read(read(cpu->PC_reg + 1));
-			cpu->PC_reg += 2;
-			cpu->cycles += 3;
-		} else if(opcode == 0xB4){//Zero page X
-			cpu->Y_reg = read((read(cpu->PC_reg + 1) + cpu->X_reg)&0xFF);
-			cpu->PC_reg += 2;
-			cpu->cycles += 4;
-		} else if(opcode == 0xAC){//Absolute
-			cpu->Y_reg = get_absolute(cpu, 0, read);
-			cpu->PC_reg += 3;
-			cpu->cycles += 4;
-		} else if(opcode == 0xBC){//Absolute X
-			cpu->Y_reg = get_absolute(cpu, cpu->X_reg, read);
-			cpu->PC_reg += 3;
-			if(CROSSED_PAGE){
-				cpu->cycles += 5;
-			} else {
-				cpu->cycles += 4;
-			}
-		}
+	//value1 stores the value before
+	//value2 stores the value after
+	value1 = bus_read(cpu->bus, address);
+	value2 = (value1<<1) | (cpu->P_reg&(1<<CARRY) ? 1 : 0);
+	bus_write(cpu->bus, address, value2);
+	set_carry(cpu, value1&0x80);
+	set_zero_negative(cpu, value2);
+}
 
-		//Set the zero flag
-		if(!cpu->Y_reg){
-			cpu->P_reg |= 1<<ZERO;
-		} else {
-			cpu->P_reg &= ~(1<<ZERO);
-		}
+void ror_a(CPU_6502 *cpu, uint16_t address){
+	uint8_t value1;
 
-		//Set the negative flag
-		if(cpu->Y_reg&0x80){
-			cpu->P_reg |= 1<<NEGATIVE;
-		} else {
-			cpu->P_reg &= ~(1<<NEGATIVE);
-		}
-	//LSR
-	} else if(opcode == 0x4A || opcode == 0x46 || opcode == 0x56 || opcode == 0x4E || opcode == 0x5E){
-		if(opcode == 0x4A){//Accumulator
-			value1 = cpu->A_reg;
-			cpu->A_reg >>= 1;
-			cpu->PC_reg++;
-			cpu->cycles += 2;
-		} else if(opcode == 0x46){//Zero page
-			value2 = read(cpu->PC_reg + 1);
-			value1 = read(value2);
-			write(value2, value1>>1);
-			cpu->PC_reg += 2;
-			cpu->cycles += 5;
-		} else if(opcode == 0x56){//Zero page X
-			value2 = read(cpu->PC_reg + 1);
-			value1 = read((value2 + cpu->X_reg)&0xFF);
-			write((value2 + cpu->X_reg)&0xFF, value1>>1);
-			cpu->PC_reg += 2;
-			cpu->cycles += 6;
-		} else if(opcode == 0x4E){//Absolute
-			value1 = get_absolute(cpu, 0, read);
-			set_absolute(cpu, 0, read, write, value1>>1);
-			cpu->PC_reg += 3;
-			cpu->cycles += 6;
-		} else if(opcode == 0x5E){//Absolute X
-			value1 = get_absolute(cpu, cpu->X_reg, read);
-			set_absolute(cpu, cpu->X_reg, read, write, value1>>1);
-			cpu->PC_reg += 3;
-			cpu->cycles += 7;
-		}
+	value1 = cpu->A_reg;
+	cpu->A_reg = (value1>>1) | (cpu->P_reg&(1<<CARRY) ? 0x80 : 0);
+	set_carry(cpu, value1&1);
+	set_zero_negative(cpu, cpu->A_reg);
+}
 
-		//Set the carry flag
-		if(value1&0x1){
-			cpu->P_reg |= 1<<CARRY;
-		} else {
-			cpu->P_reg &= ~(1<<CARRY);
-		}
+void ror(CPU_6502 *cpu, uint16_t address){
+	uint8_t value1;
+	uint8_t value2;
 
-		//Set the zero flag
-		if(!(value1>>1)){
-			cpu->P_reg |= 1<<ZERO;
-		} else {
-			cpu->P_reg &= ~(1<<ZERO);
-		}
+	//value1 stores the value before
+	//value2 stores the value after
+	value1 = bus_read(cpu->bus, address);
+	value2 = (value1>>1) | (cpu->P_reg&(1<<CARRY) ? 0x80 : 0);
+	bus_write(cpu->bus, address, value2);
+	set_carry(cpu, value1&1);
+	set_zero_negative(cpu, value2);
+}
 
-		//The negative flag is always set to zero
-		cpu->P_reg &= ~(1<<NEGATIVE);
-	//ORA
-	} else if(opcode == 0x09 || opcode == 0x05 || opcode == 0x15 || opcode == 0x0D || opcode == 0x1D || opcode == 0x19 || opcode == 0x01 || opcode == 0x11){
-		if(opcode == 0x09){//Immediate
-			cpu->A_reg |= read(cpu->PC_reg + 1);
-			cpu->PC_reg += 2;
-			cpu->cycles += 2;
-		} else if(opcode == 0x05){//Zero page
-			cpu->A_reg |= read(read(cpu->PC_reg + 1));
-			cpu->PC_reg += 2;
-			cpu->cycles += 3;
-		} else if(opcode == 0x15){//Zero page X
-			cpu->A_reg |= read((read(cpu->PC_reg + 1) + cpu->X_reg)&0xFF);
-			cpu->PC_reg += 2;
-			cpu->cycles += 4;
-		} else if(opcode == 0x0D){//Absolute
-			cpu->A_reg |= get_absolute(cpu, 0, read);
-			cpu->PC_reg += 3;
-			cpu->cycles += 4;
-		} else if(opcode == 0x1D){//Absolute X
-			cpu->A_reg |= get_absolute(cpu, cpu->X_reg, read);
-			cpu->PC_reg += 3;
-			if(CROSSED_PAGE){
-				cpu->cycles += 5;
-			} else {
-				cpu->cycles += 4;
-			}
-		} else if(opcode == 0x19){//Absolute Y
-			cpu->A_reg |= get_absolute(cpu, cpu->Y_reg, read);
-			cpu->PC_reg += 3;
-			if(CROSSED_PAGE){
-				cpu->cycles += 5;
-			} else {
-				cpu->cycles += 4;
-			}
-		} else if(opcode == 0x01){//Indirect X
-			cpu->A_reg |= get_indirect_X(cpu, read(cpu->PC_reg + 1), read);
-			cpu->PC_reg += 2;
-			cpu->cycles += 6;
-		} else if(opcode == 0x11){//Indirect Y
-			cpu->A_reg |= get_indirect_Y(cpu, read(cpu->PC_reg + 1), read);
-			cpu->PC_reg += 2;
-			if(CROSSED_PAGE){
-				cpu->cycles += 6;
-			} else {
-				cpu->cycles += 5;
-			}
-		}
+void rti(CPU_6502 *cpu, uint16_t address){
+	uint8_t value1;
+	uint8_t value2;
 
-		//Set zero flag
-		if(!cpu->A_reg){
-			cpu->P_reg |= 1<<ZERO;
-		} else {
-			cpu->P_reg &= ~(1<<ZERO);
-		}
+	set_status_6502(cpu, pop(cpu));
+	value1 = pop(cpu);
+	value2 = pop(cpu);
+	cpu->PC_reg = (((uint16_t) value1)<<8) | value2;
+}
 
-		//Set negative flag
-		if(cpu->A_reg&0x80){
-			cpu->P_reg |= 1<<NEGATIVE;
-		} else {
-			cpu->P_reg &= ~(1<<NEGATIVE);
-		}
-	//PHA
-	} else if(opcode == 0x48){
-		push(cpu, write, cpu->A_reg);
-		cpu->PC_reg += 1;
-		cpu->cycles += 3;
-	//PHP (sucks)
-	} else if(opcode == 0x08){
-		push(cpu, write, cpu->P_reg);
-		cpu->PC_reg += 1;
-		cpu->cycles += 3;
-	//PLA
-	} else if(opcode == 0x68){
-		cpu->A_reg = pop(cpu, read);
-		cpu->PC_reg += 1;
-		cpu->cycles += 4;
-
-		//Set the zero flag
-		if(!cpu->A_reg){
-			cpu->P_reg |= 1<<ZERO;
-		} else {
-			cpu->P_reg &= ~(1<<ZERO);
-		}
-		
-		//Set the negative flag
-		if(cpu->A_reg&0x80){
-			cpu->P_reg |= 1<<NEGATIVE;
-		} else {
-			cpu->P_reg &= ~(1<<NEGATIVE);
-		}
-	//PLP
-	} else if(opcode == 0x28){
-		cpu->P_reg = pop(cpu, read);
-		cpu->PC_reg += 1;
-		cpu->cycles += 4;
-	//ROL
-	} else if(opcode == 0x2A || opcode == 0x26 || opcode == 0x36 || opcode == 0x2E || opcode == 0x3E){
-		//Determine whether to append a 1 or 0 for bit 0
-		if(cpu->P_reg&(1<<CARRY)){
-			value2 = 1;
-		} else {
-			value2 = 0;
-		}
-		if(opcode == 0x2A){//Accumulator
-			value1 = cpu->A_reg;
-			cpu->A_reg = (value1<<1) | value2;
-			cpu->PC_reg += 1;
-			cpu->cycles += 2;
-		} else if(opcode == 0x26){//Zero page
-			value3 = read(cpu->PC_reg + 1);
-			value1 = read(value3);
-			write(value3, (value1<<1) | value2);
-			cpu->PC_reg += 2;
-			cpu->cycles += 5;
-		} else if(opcode == 0x36){//Zero page X
-			value3 = read(cpu->PC_reg + 1);
-			value1 = read((value3 + cpu->X_reg)&0xFF);
-			write((value3 + cpu->X_reg)&0xFF, (value1<<1) | value2);
-			cpu->PC_reg += 2;
-			cpu->cycles += 6;
-		} else if(opcode == 0x2E){//Absolute
-			value1 = get_absolute(cpu, 0, read);
-			set_absolute(cpu, 0, read, write, (value1<<1) | value2);
-			cpu->PC_reg += 3;
-			cpu->cycles += 6;
-		} else if(opcode == 0x3E){//Absolute X
-			value1 = get_absolute(cpu, cpu->X_reg, read);
-			set_absolute(cpu, cpu->X_reg, read, write, (value1<<1) | value2);
-			cpu->PC_reg += 3;
-			cpu->cycles += 7;
-		}
+void rts(CPU_6502 *cpu, uint16_t address){
+	uint8_t value1;
+	uint8_t value2;
 
-		value2 = (value1<<1) | value2;
-		//value1 stores the value before
-		//value2 stores the value after
+	value1 = pop(cpu);
+	value2 = pop(cpu);
+	cpu->PC_reg = (((uint16_t) value1)<<8) | value2;
+	cpu->PC_reg++;
+}
 
-		//Set the carry flag
-		if(value1&0x80){
-			cpu->P_reg |= 1<<CARRY;
-		} else {
-			cpu->P_reg &= ~(1<<CARRY);
-		}
+void sbc(CPU_6502 *cpu, uint16_t address){
+	uint8_t value2;
+	uint8_t value3;
 
-		//Set the zero flag
-		if(!value2){
-			cpu->P_reg |= 1<<ZERO;
-		} else {
-			cpu->P_reg &= ~(1<<ZERO);
-		}
+	value2 = cpu->A_reg;
+	value3 = ~bus_read(cpu->bus, address);//One's complement
+	if(cpu->P_reg&(1<<CARRY)){
+		value3++;
+	}
+	cpu->A_reg += value3;
 
-		//Set the negative flag
-		if(value2&0x80){
-			cpu->P_reg |= 1<<NEGATIVE;
-		} else {
-			cpu->P_reg &= ~(1<<NEGATIVE);
-		}
-	//ROR
-	} else if(opcode == 0x6A || opcode == 0x66 || opcode == 0x76 || opcode == 0x6E || opcode == 0x7E){
-		//Determine whether to append a 1 or 0 for bit 7
-		if(cpu->P_reg&(1<<CARRY)){
-			value2 = 0x80;
-		} else {
-			value2 = 0;
-		}
-		if(opcode == 0x6A){//Accumulator
-			value1 = cpu->A_reg;
-			cpu->A_reg = (value1>>1) | value2;
-			cpu->PC_reg += 1;
-			cpu->cycles += 2;
-		} else if(opcode == 0x66){//Zero page
-			value3 = read(cpu->PC_reg + 1);
-			value1 = read(value3);
-			write(value3, (value1>>1) | value2);
-			cpu->PC_reg += 2;
-			cpu->cycles += 5;
-		} else if(opcode == 0x76){//Zero page X
-			value3 = read(cpu->PC_reg + 1);
-			value1 = read((value3 + cpu->X_reg)&0xFF);
-			write((value3 + cpu->X_reg)&0xFF, (value1>>1) | value2);
-			cpu->PC_reg += 2;
-			cpu->cycles += 6;
-		} else if(opcode == 0x6E){//Absolute
-			value1 = get_absolute(cpu, 0, read);
-			set_absolute(cpu, 0, read, write, (value1>>1) | value2);
-			cpu->PC_reg += 3;
-			cpu->cycles += 6;
-		} else if(opcode == 0x7E){//Absolute X
-			value1 = get_absolute(cpu, cpu->X_reg, read);
-			set_absolute(cpu, cpu->X_reg, read, write, (value1>>1) | value2);
-			cpu->PC_reg += 3;
-			cpu->cycles += 7;
-		}
+	//If the CPU is in decimal state, correct output
+	if((cpu->P_reg&(1<<DECIMAL)) && (cpu->A_reg&0xF) > 9){
+		cpu->A_reg -= 6;
+	}
 
-		value2 = (value1>>1) | value2;
-		//value1 stores the value before
-		//value2 stores the value after
+	//Set the overflow flag
+	set_overflow(cpu, ((value2&0x80) && (value3&0x80) && !(cpu->A_reg&0x80)) || (!(value2&0x80) && !(value3&0x80) && (cpu->A_reg&0x80)));
+	//Set the carry flag
+	set_carry(cpu, cpu->A_reg <= value2);
+	set_zero_negative(cpu, cpu->A_reg);
+}
 
-		//Set the carry flag
-		if(value1&1){
-			cpu->P_reg |= 1<<CARRY;
-		} else {
-			cpu->P_reg &= ~(1<<CARRY);
-		}
+void sec(CPU_6502 *cpu, uint16_t address){
+	cpu->P_reg |= 1<<CARRY;
+}
 
-		//Set the zero flag
-		if(!value2){
-			cpu->P_reg |= 1<<ZERO;
-		} else {
-			cpu->P_reg &= ~(1<<ZERO);
-		}
+void sed(CPU_6502 *cpu, uint16_t address){
+	cpu->P_reg |= 1<<DECIMAL;
+}
 
-		//Set the negative flag
-		if(value2&0x80){
-			cpu->P_reg |= 1<<NEGATIVE;
-		} else {
-			cpu->P_reg &= ~(1<<NEGATIVE);
-		}
-	//RTI
-	} else if(opcode == 0x40){
-		cpu->P_reg = pop(cpu, read);
-		value1 = pop(cpu, read);
-		value2 = pop(cpu, read);
-		cpu->PC_reg = (((uint16_t) value1)<<8) | value2;
-		cpu->cycles += 6;
-	//RTS
-	} else if(opcode == 0x60){
-		value1 = pop(cpu, read);
-		value2 = pop(cpu, read);
-		cpu->PC_reg = (((uint16_t) value1)<<8) | value2;
-		cpu->PC_reg++;
-		cpu->cycles += 6;
-	//SBC
-	} else if(opcode == 0xE9 || opcode == 0xE5 || opcode == 0xF5 || opcode == 0xED || opcode == 0xFD || opcode == 0xF9 || opcode == 0xE1 || opcode == 0xF1){
-		if(opcode == 0xE9){//Immediate
-			value1 = read(cpu->PC_reg + 1);
-			cpu->PC_reg += 2;
-			cpu->cycles += 2;
-		} else if(opcode == 0xE5){//Zero page
-			value1 = read(read(cpu->PC_reg + 1));
-			cpu->PC_reg += 2;
-			cpu->cycles += 3;
-		} else if(opcode == 0xF5){//Zero page X
-			value1 = read((read(cpu->PC_reg + 1) + cpu->X_reg)&0xFF);
-			cpu->PC_reg += 2;
-			cpu->cycles += 4;
-		} else if(opcode == 0xED){//Absolute
-			value1 = get_absolute(cpu, 0, read);
-			cpu->PC_reg += 3;
-			cpu->cycles += 4;
-		} else if(opcode == 0xFD){//Absolute X
-			value1 = get_absolute(cpu, cpu->X_reg, read);
-			cpu->PC_reg += 3;
-			if(CROSSED_PAGE){
-				cpu->cycles += 5;
-			} else {
-				cpu->cycles += 4;
-			}
-		} else if(opcode == 0xF9){//Absolute Y
-			value1 = get_absolute(cpu, cpu->Y_reg, read);
-			cpu->PC_reg += 3;
-			if(CROSSED_PAGE){
-				cpu->cycles += 5;
-			} else {
-				cpu->cycles += 4;
-			}
-		} else if(opcode == 0xE1){//Indirect X
-			value1 = get_indirect_X(cpu, read(cpu->PC_reg + 1), read);
-			cpu->PC_reg += 2;
-			cpu->cycles += 6;
-		} else if(opcode == 0xF1){//Indirect Y
-			value1 = get_indirect_Y(cpu, read(cpu->PC_reg + 1), read);
-			cpu->PC_reg += 2;
-			if(CROSSED_PAGE){
-				cpu->cycles += 6;
-			} else {
-				cpu->cycles += 5;
+void sei(CPU_6502 *cpu, uint16_t address){
+	cpu->P_reg |= 1<<INTERRUPT;
+}
+
+void sta(CPU_6502 *cpu, uint16_t address){
+	bus_write(cpu->bus, address, cpu->A_reg);
+}
+
+void stx(CPU_6502 *cpu, uint16_t address){
+	bus_write(cpu->bus, address, cpu->X_reg);
+}
+
+void sty(CPU_6502 *cpu, uint16_t address){
+	bus_write(cpu->bus, address, cpu->Y_reg);
+}
+
+void tax(CPU_6502 *cpu, uint16_t address){
+	cpu->X_reg = cpu->A_reg;
+	set_zero_negative(cpu, cpu->X_reg);
+}
+
+void tay(CPU_6502 *cpu, uint16_t address){
+	cpu->Y_reg = cpu->A_reg;
+	set_zero_negative(cpu, cpu->Y_reg);
+}
+
+void tsx(CPU_6502 *cpu, uint16_t address){
+	cpu->X_reg = cpu->SP_reg;
+	set_zero_negative(cpu, cpu->X_reg);
+}
+
+void txa(CPU_6502 *cpu, uint16_t address){
+	cpu->A_reg = cpu->X_reg;
+	set_zero_negative(cpu, cpu->A_reg);
+}
+
+void txs(CPU_6502 *cpu, uint16_t address){
+	cpu->SP_reg = cpu->X_reg;
+}
+
+void tya(CPU_6502 *cpu, uint16_t address){
+	cpu->A_reg = cpu->Y_reg;
+	set_zero_negative(cpu, cpu->A_reg);
+}
+
+//Unknown operation
+//The CPU stops on the opcode and leaves it to the host to report
+void unknown(CPU_6502 *cpu, uint16_t address){
+	cpu->PC_reg--;
+	cpu->halted = 1;
+	cpu->bus->event = 1;
+}
+
+//The first byte at PC uniquely determines the operation
+static const OPCODE opcodes[256] = {
+	{brk, IMPLIED, 7, 0},//0x00
+	{ora, INDIRECT_X, 6, 0},//0x01
+	{unknown, IMPLIED, 0, 0},//0x02
+	{unknown, IMPLIED, 0, 0},//0x03
+	{unknown, IMPLIED, 0, 0},//0x04
+	{ora, ZERO_PAGE, 3, 0},//0x05
+	{asl, ZERO_PAGE, 5, 0},//0x06
+	{unknown, IMPLIED, 0, 0},//0x07
+	{php, IMPLIED, 3, 0},//0x08
+	{ora, IMMEDIATE, 2, 0},//0x09
+	{asl_a, IMPLIED, 2, 0},//0x0A
+	{unknown, IMPLIED, 0, 0},//0x0B
+	{unknown, IMPLIED, 0, 0},//0x0C
+	{ora, ABSOLUTE, 4, 0},//0x0D
+	{asl, ABSOLUTE, 6, 0},//0x0E
+	{unknown, IMPLIED, 0, 0},//0x0F
+	{bpl, RELATIVE, 2, 0},//0x10
+	{ora, INDIRECT_Y, 5, 1},//0x11
+	{unknown, IMPLIED, 0, 0},//0x12
+	{unknown, IMPLIED, 0, 0},//0x13
+	{unknown, IMPLIED, 0, 0},//0x14
+	{ora, ZERO_PAGE_X, 4, 0},//0x15
+	{asl, ZERO_PAGE_X, 6, 0},//0x16
+	{unknown, IMPLIED, 0, 0},//0x17
+	{clc, IMPLIED, 2, 0},//0x18
+	{ora, ABSOLUTE_Y, 4, 1},//0x19
+	{unknown, IMPLIED, 0, 0},//0x1A
+	{unknown, IMPLIED, 0, 0},//0x1B
+	{unknown, IMPLIED, 0, 0},//0x1C
+	{ora, ABSOLUTE_X, 4, 1},//0x1D
+	{asl, ABSOLUTE_X, 7, 0},//0x1E
+	{unknown, IMPLIED, 0, 0},//0x1F
+	{jsr, ABSOLUTE, 6, 0},//0x20
+	{and, INDIRECT_X, 6, 0},//0x21
+	{unknown, IMPLIED, 0, 0},//0x22
+	{unknown, IMPLIED, 0, 0},//0x23
+	{bit, ZERO_PAGE, 3, 0},//0x24
+	{and, ZERO_PAGE, 3, 0},//0x25
+	{rol, ZERO_PAGE, 5, 0},//0x26
+	{unknown, IMPLIED, 0, 0},//0x27
+	{plp, IMPLIED, 4, 0},//0x28
+	{and, IMMEDIATE, 2, 0},//0x29
+	{rol_a, IMPLIED, 2, 0},//0x2A
+	{unknown, IMPLIED, 0, 0},//0x2B
+	{bit, ABSOLUTE, 4, 0},//0x2C
+	{and, ABSOLUTE, 4, 0},//0x2D
+	{rol, ABSOLUTE, 6, 0},//0x2E
+	{unknown, IMPLIED, 0, 0},//0x2F
+	{bmi, RELATIVE, 2, 0},//0x30
+	{and, INDIRECT_Y, 5, 1},//0x31
+	{unknown, IMPLIED, 0, 0},//0x32
+	{unknown, IMPLIED, 0, 0},//0x33
+	{unknown, IMPLIED, 0, 0},//0x34
+	{and, ZERO_PAGE_X, 4, 0},//0x35
+	{rol, ZERO_PAGE_X, 6, 0},//0x36
+	{unknown, IMPLIED, 0, 0},//0x37
+	{sec, IMPLIED, 2, 0},//0x38
+	{and, ABSOLUTE_Y, 4, 1},//0x39
+	{unknown, IMPLIED, 0, 0},//0x3A
+	{unknown, IMPLIED, 0, 0},//0x3B
+	{unknown, IMPLIED, 0, 0},//0x3C
+	{and, ABSOLUTE_X, 4, 1},//0x3D
+	{rol, ABSOLUTE_X, 7, 0},//0x3E
+	{unknown, IMPLIED, 0, 0},//0x3F
+	{rti, IMPLIED, 6, 0},//0x40
+	{eor, INDIRECT_X, 6, 0},//0x41
+	{unknown, IMPLIED, 0, 0},//0x42
+	{unknown, IMPLIED, 0, 0},//0x43
+	{unknown, IMPLIED, 0, 0},//0x44
+	{eor, ZERO_PAGE, 3, 0},//0x45
+	{lsr, ZERO_PAGE, 5, 0},//0x46
+	{unknown, IMPLIED, 0, 0},//0x47
+	{pha, IMPLIED, 3, 0},//0x48
+	{eor, IMMEDIATE, 2, 0},//0x49
+	{lsr_a, IMPLIED, 2, 0},//0x4A
+	{unknown, IMPLIED, 0, 0},//0x4B
+	{jmp, ABSOLUTE, 3, 0},//0x4C
+	{eor, ABSOLUTE, 4, 0},//0x4D
+	{lsr, ABSOLUTE, 6, 0},//0x4E
+	{unknown, IMPLIED, 0, 0},//0x4F
+	{bvc, RELATIVE, 2, 0},//0x50
+	{eor, INDIRECT_Y, 5, 1},//0x51
+	{unknown, IMPLIED, 0, 0},//0x52
+	{unknown, IMPLIED, 0, 0},//0x53
+	{unknown, IMPLIED, 0, 0},//0x54
+	{eor, ZERO_PAGE_X, 4, 0},//0x55
+	{lsr, ZERO_PAGE_X, 6, 0},//0x56
+	{unknown, IMPLIED, 0, 0},//0x57
+	{cli, IMPLIED, 2, 0},//0x58
+	{eor, ABSOLUTE_Y, 4, 1},//0x59
+	{unknown, IMPLIED, 0, 0},//0x5A
+	{unknown, IMPLIED, 0, 0},//0x5B
+	{unknown, IMPLIED, 0, 0},//0x5C
+	{eor, ABSOLUTE_X, 4, 1},//0x5D
+	{lsr, ABSOLUTE_X, 7, 0},//0x5E
+	{unknown, IMPLIED, 0, 0},//0x5F
+	{rts, IMPLIED, 6, 0},//0x60
+	{adc, INDIRECT_X, 6, 0},//0x61
+	{unknown, IMPLIED, 0, 0},//0x62
+	{unknown, IMPLIED, 0, 0},//0x63
+	{unknown, IMPLIED, 0, 0},//0x64
+	{adc, ZERO_PAGE, 3, 0},//0x65
+	{ror, ZERO_PAGE, 5, 0},//0x66
+	{unknown, IMPLIED, 0, 0},//0x67
+	{pla, IMPLIED, 4, 0},//0x68
+	{adc, IMMEDIATE, 2, 0},//0x69
+	{ror_a, IMPLIED, 2, 0},//0x6A
+	{unknown, IMPLIED, 0, 0},//0x6B
+	{jmp, INDIRECT, 5, 0},//0x6C
+	{adc, ABSOLUTE, 4, 0},//0x6D
+	{ror, ABSOLUTE, 6, 0},//0x6E
+	{unknown, IMPLIED, 0, 0},//0x6F
+	{bvs, RELATIVE, 2, 0},//0x70
+	{adc, INDIRECT_Y, 5, 1},//0x71
+	{unknown, IMPLIED, 0, 0},//0x72
+	{unknown, IMPLIED, 0, 0},//0x73
+	{unknown, IMPLIED, 0, 0},//0x74
+	{adc, ZERO_PAGE_X, 4, 0},//0x75
+	{ror, ZERO_PAGE_X, 6, 0},//0x76
+	{unknown, IMPLIED, 0, 0},//0x77
+	{sei, IMPLIED, 2, 0},//0x78
+	{adc, ABSOLUTE_Y, 4, 1},//0x79
+	{unknown, IMPLIED, 0, 0},//0x7A
+	{unknown, IMPLIED, 0, 0},//0x7B
+	{unknown, IMPLIED, 0, 0},//0x7C
+	{adc, ABSOLUTE_X, 4, 1},//0x7D
+	{ror, ABSOLUTE_X, 7, 0},//0x7E
+	{unknown, IMPLIED, 0, 0},//0x7F
+	{unknown, IMPLIED, 0, 0},//0x80
+	{sta, INDIRECT_X, 6, 0},//0x81
+	{unknown, IMPLIED, 0, 0},//0x82
+	{unknown, IMPLIED, 0, 0},//0x83
+	{sty, ZERO_PAGE, 3, 0},//0x84
+	{sta, ZERO_PAGE, 3, 0},//0x85
+	{stx, ZERO_PAGE, 3, 0},//0x86
+	{unknown, IMPLIED, 0, 0},//0x87
+	{dey, IMPLIED, 2, 0},//0x88
+	{unknown, IMPLIED, 0, 0},//0x89
+	{txa, IMPLIED, 2, 0},//0x8A
+	{unknown, IMPLIED, 0, 0},//0x8B
+	{sty, ABSOLUTE, 4, 0},//0x8C
+	{sta, ABSOLUTE, 4, 0},//0x8D
+	{stx, ABSOLUTE, 4, 0},//0x8E
+	{unknown, IMPLIED, 0, 0},//0x8F
+	{bcc, RELATIVE, 2, 0},//0x90
+	{sta, INDIRECT_Y, 6, 0},//0x91
+	{unknown, IMPLIED, 0, 0},//0x92
+	{unknown, IMPLIED, 0, 0},//0x93
+	{sty, ZERO_PAGE_X, 4, 0},//0x94
+	{sta, ZERO_PAGE_X, 4, 0},//0x95
+	{stx, ZERO_PAGE_Y, 4, 0},//0x96
+	{unknown, IMPLIED, 0, 0},//0x97
+	{tya, IMPLIED, 2, 0},//0x98
+	{sta, ABSOLUTE_Y, 5, 0},//0x99
+	{txs, IMPLIED, 2, 0},//0x9A
+	{unknown, IMPLIED, 0, 0},//0x9B
+	{unknown, IMPLIED, 0, 0},//0x9C
+	{sta, ABSOLUTE_X, 5, 0},//0x9D
+	{unknown, IMPLIED, 0, 0},//0x9E
+	{unknown, IMPLIED, 0, 0},//0x9F
+	{ldy, IMMEDIATE, 2, 0},//0xA0
+	{lda, INDIRECT_X, 6, 0},//0xA1
+	{ldx, IMMEDIATE, 2, 0},//0xA2
+	{unknown, IMPLIED, 0, 0},//0xA3
+	{ldy, ZERO_PAGE, 3, 0},//0xA4
+	{lda, ZERO_PAGE, 3, 0},//0xA5
+	{ldx, ZERO_PAGE, 3, 0},//0xA6
+	{unknown, IMPLIED, 0, 0},//0xA7
+	{tay, IMPLIED, 2, 0},//0xA8
+	{lda, IMMEDIATE, 2, 0},//0xA9
+	{tax, IMPLIED, 2, 0},//0xAA
+	{unknown, IMPLIED, 0, 0},//0xAB
+	{ldy, ABSOLUTE, 4, 0},//0xAC
+	{lda, ABSOLUTE, 4, 0},//0xAD
+	{ldx, ABSOLUTE, 4, 0},//0xAE
+	{unknown, IMPLIED, 0, 0},//0xAF
+	{bcs, RELATIVE, 2, 0},//0xB0
+	{lda, INDIRECT_Y, 5, 1},//0xB1
+	{unknown, IMPLIED, 0, 0},//0xB2
+	{unknown, IMPLIED, 0, 0},//0xB3
+	{ldy, ZERO_PAGE_X, 4, 0},//0xB4
+	{lda, ZERO_PAGE_X, 4, 0},//0xB5
+	{ldx, ZERO_PAGE_Y, 4, 0},//0xB6
+	{unknown, IMPLIED, 0, 0},//0xB7
+	{clv, IMPLIED, 2, 0},//0xB8
+	{lda, ABSOLUTE_Y, 4, 1},//0xB9
+	{tsx, IMPLIED, 2, 0},//0xBA
+	{unknown, IMPLIED, 0, 0},//0xBB
+	{ldy, ABSOLUTE_X, 4, 1},//0xBC
+	{lda, ABSOLUTE_X, 4, 1},//0xBD
+	{ldx, ABSOLUTE_Y, 4, 1},//0xBE
+	{unknown, IMPLIED, 0, 0},//0xBF
+	{cpy, IMMEDIATE, 2, 0},//0xC0
+	{cmp, INDIRECT_X, 6, 0},//0xC1
+	{unknown, IMPLIED, 0, 0},//0xC2
+	{unknown, IMPLIED, 0, 0},//0xC3
+	{cpy, ZERO_PAGE, 3, 0},//0xC4
+	{cmp, ZERO_PAGE, 3, 0},//0xC5
+	{dec, ZERO_PAGE, 5, 0},//0xC6
+	{unknown, IMPLIED, 0, 0},//0xC7
+	{iny, IMPLIED, 2, 0},//0xC8
+	{cmp, IMMEDIATE, 2, 0},//0xC9
+	{dex, IMPLIED, 2, 0},//0xCA
+	{unknown, IMPLIED, 0, 0},//0xCB
+	{cpy, ABSOLUTE, 4, 0},//0xCC
+	{cmp, ABSOLUTE, 4, 0},//0xCD
+	{dec, ABSOLUTE, 6, 0},//0xCE
+	{unknown, IMPLIED, 0, 0},//0xCF
+	{bne, RELATIVE, 2, 0},//0xD0
+	{cmp, INDIRECT_Y, 5, 1},//0xD1
+	{unknown, IMPLIED, 0, 0},//0xD2
+	{unknown, IMPLIED, 0, 0},//0xD3
+	{unknown, IMPLIED, 0, 0},//0xD4
+	{cmp, ZERO_PAGE_X, 4, 0},//0xD5
+	{dec, ZERO_PAGE_X, 6, 0},//0xD6
+	{unknown, IMPLIED, 0, 0},//0xD7
+	{cld, IMPLIED, 2, 0},//0xD8
+	{cmp, ABSOLUTE_Y, 4, 1},//0xD9
+	{unknown, IMPLIED, 0, 0},//0xDA
+	{unknown, IMPLIED, 0, 0},//0xDB
+	{unknown, IMPLIED, 0, 0},//0xDC
+	{cmp, ABSOLUTE_X, 4, 1},//0xDD
+	{dec, ABSOLUTE_X, 7, 0},//0xDE
+	{unknown, IMPLIED, 0, 0},//0xDF
+	{cpx, IMMEDIATE, 2, 0},//0xE0
+	{sbc, INDIRECT_X, 6, 0},//0xE1
+	{unknown, IMPLIED, 0, 0},//0xE2
+	{unknown, IMPLIED, 0, 0},//0xE3
+	{cpx, ZERO_PAGE, 3, 0},//0xE4
+	{sbc, ZERO_PAGE, 3, 0},//0xE5
+	{inc, ZERO_PAGE, 5, 0},//0xE6
+	{unknown, IMPLIED, 0, 0},//0xE7
+	{inx, IMPLIED, 2, 0},//0xE8
+	{sbc, IMMEDIATE, 2, 0},//0xE9
+	{nop, IMPLIED, 2, 0},//0xEA
+	{unknown, IMPLIED, 0, 0},//0xEB
+	{cpx, ABSOLUTE, 4, 0},//0xEC
+	{sbc, ABSOLUTE, 4, 0},//0xED
+	{inc, ABSOLUTE, 6, 0},//0xEE
+	{unknown, IMPLIED, 0, 0},//0xEF
+	{beq, RELATIVE, 2, 0},//0xF0
+	{sbc, INDIRECT_Y, 5, 1},//0xF1
+	{unknown, IMPLIED, 0, 0},//0xF2
+	{unknown, IMPLIED, 0, 0},//0xF3
+	{unknown, IMPLIED, 0, 0},//0xF4
+	{sbc, ZERO_PAGE_X, 4, 0},//0xF5
+	{inc, ZERO_PAGE_X, 6, 0},//0xF6
+	{unknown, IMPLIED, 0, 0},//0xF7
+	{sed, IMPLIED, 2, 0},//0xF8
+	{sbc, ABSOLUTE_Y, 4, 1},//0xF9
+	{unknown, IMPLIED, 0, 0},//0xFA
+	{unknown, IMPLIED, 0, 0},//0xFB
+	{unknown, IMPLIED, 0, 0},//0xFC
+	{sbc, ABSOLUTE_X, 4, 1},//0xFD
+	{inc, ABSOLUTE_X, 7, 0},//0xFE
+	{unknown, IMPLIED, 0, 0},//0xFF
+};
+
+static inline void step_6502(CPU_6502 *cpu){
+	const OPCODE *op;
+	uint16_t address;
+
+	op = opcodes + bus_read(cpu->bus, cpu->PC_reg);
+	cpu->crossed_page = 0;
+	address = get_address(cpu, op->mode);
+	cpu->PC_reg += mode_lengths[op->mode];
+
+	op->operation(cpu, address);
+
+	cpu->cycles += op->cycles;
+	if(op->page_penalty && cpu->crossed_page){
+		cpu->cycles++;
+	}
+}
+
+const OPCODE *decode_6502(uint8_t opcode){
+	if(opcodes[opcode].operation == unknown){
+		return NULL;
+	}
+	return opcodes + opcode;
+}
+
+/*
+ * Decode cache
+ *
+ * Instructions are decoded the first time they run and kept by address.
+ * Pages of RAM holding decoded instructions are marked on the bus, and a
+ * write to one drops every instruction read from it. ROM never changes,
+ * so its instructions are only ever decoded once.
+ */
+
+static int can_cache(CPU_6502 *cpu, unsigned int address){
+	return address <= 0xFFFF && cpu->bus->read_pages[address>>8] && cpu->decode_cache->invalidations[address>>8] < DECODE_MAX_INVALIDATIONS;
+}
+
+static void decoded_code_written(void *context, uint16_t address){
+	CPU_6502 *cpu = context;
+	DECODE_CACHE *cache = cpu->decode_cache;
+	unsigned int page;
+	unsigned int first;
+
+	//Instructions starting up to two bytes before the page can run into it
+	page = address>>8;
+	first = page ? page*0x100 - 2 : 0;
+	memset(cache->entries + first, 0, (page*0x100 + 0x100 - first)*sizeof(DECODED));
+	protect_code_page(cpu->bus, page, cache->watcher, 0);
+	cache->invalidations[page]++;
+}
+
+//Decode the instruction at PC, keeping it if it came straight from RAM or ROM
+static DECODED *decode_instruction(CPU_6502 *cpu, DECODED *decoded, DECODED *uncached){
+	const OPCODE *op;
+	unsigned int page;
+
+	op = opcodes + bus_read(cpu->bus, cpu->PC_reg);
+	if(!can_cache(cpu, cpu->PC_reg) || !can_cache(cpu, cpu->PC_reg + mode_lengths[op->mode] - 1)){
+		decoded = uncached;
+	}
+	decoded->operand = get_operand(cpu, op->mode);
+	decoded->mode = op->mode;
+	decoded->length = mode_lengths[op->mode];
+	decoded->cycles = op->cycles;
+	decoded->page_penalty = op->page_penalty;
+	decoded->operation = op->operation;
+
+	if(decoded != uncached){
+		for(page = cpu->PC_reg>>8; page <= (cpu->PC_reg + decoded->length - 1)>>8; page++){
+			if(is_ram_page(cpu->bus, page) && !(cpu->bus->code_pages[page]&(1<<cpu->decode_cache->watcher))){
+				protect_code_page(cpu->bus, page, cpu->decode_cache->watcher, 1);
 			}
 		}
+	}
 
-		value2 = cpu->A_reg;
-		value3 = (~value1);//One's complement
-		if(cpu->P_reg&(1<<CARRY)){
-			value3++;
-			cpu->A_reg += value3;
-		} else {
-			cpu->A_reg += value3;
-		}
+	return decoded;
+}
 
-		//If the CPU is in decimal state, correct output
-		if((cpu->P_reg&(1<<DECIMAL)) && (cpu->A_reg&0xF) > 9){
-			cpu->A_reg -= 6;
-		}
+static inline void step_cached_6502(CPU_6502 *cpu){
+	DECODED *decoded;
+	DECODED uncached;
+	uint16_t address;
+	unsigned char cycles;
+	unsigned char page_penalty;
 
-		//Set the overflow flag
-		if(((value2&0x80) && (value3&0x80) && !(cpu->A_reg&0x80)) || (!(value2&0x80) && !(value3&0x80) && (cpu->A_reg&0x80))){
-			cpu->P_reg |= 1<<OVERFLOW;
-		} else {
-			cpu->P_reg &= ~(1<<OVERFLOW);
-		}
+	decoded = cpu->decode_cache->entries + cpu->PC_reg;
+	if(!decoded->operation){
+		decoded = decode_instruction(cpu, decoded, &uncached);
+	}
+	cpu->crossed_page = 0;
+	address = resolve_operand(cpu, decoded->mode, decoded->operand);
+	cpu->PC_reg += decoded->length;
+	//The operation may write over its own instruction and drop it
+	cycles = decoded->cycles;
+	page_penalty = decoded->page_penalty;
+
+	decoded->operation(cpu, address);
+
+	cpu->cycles += cycles;
+	if(page_penalty && cpu->crossed_page){
+		cpu->cycles++;
+	}
+}
 
-		//Set the carry flag
-		if(cpu->A_reg <= value2){
-			cpu->P_reg |= 1<<CARRY;
-		} else {
-			cpu->P_reg &= ~(1<<CARRY);
-		}
-		
-		//Set the zero flag
-		if(!cpu->A_reg){
-			cpu->P_reg |= 1<<ZERO;
-		} else {
-			cpu->P_reg &= ~(1<<ZERO);
-		}
+int enable_decode_cache(CPU_6502 *cpu){
+	DECODE_CACHE *cache;
 
-		//Set the negative flag
-		if(cpu->A_reg&0x80){
-			cpu->P_reg |= 1<<NEGATIVE;
-		} else {
-			cpu->P_reg &= ~(1<<NEGATIVE);
-		}
-	//SEC
-	} else if(opcode == 0x38){
-		cpu->P_reg |= 1<<CARRY;
-		cpu->PC_reg += 1;
-		cpu->cycles += 2;
-	//SED
-	} else if(opcode == 0xF8){
-		cpu->P_reg |= 1<<DECIMAL;
-		cpu->PC_reg += 1;
-		cpu->cycles += 2;
-	//SEI
-	} else if(opcode == 0x78){
-		cpu->P_reg |= 1<<INTERRUPT;
-		cpu->PC_reg += 1;
-		cpu->cycles += 2;
-	//STA
-	} else if(opcode == 0x85 || opcode == 0x95 || opcode == 0x8D || opcode == 0x9D || opcode == 0x99 || opcode == 0x81 || opcode == 0x91){
-		if(opcode == 0x85){//Zero page
-			write(read(cpu->PC_reg + 1), cpu->A_reg);
-			cpu->PC_reg += 2;
-			cpu->cycles += 3;
-		} else if(opcode == 0x95){//Zero page X
-			write((read(cpu->PC_reg + 1) + cpu->X_reg)&0xFF, cpu->A_reg);
-			cpu->PC_reg += 2;
-			cpu->cycles += 4;
-		} else if(opcode == 0x8D){//Absolute
-			set_absolute(cpu, 0, read, write, cpu->A_reg);
-			cpu->PC_reg += 3;
-			cpu->cycles += 4;
-		} else if(opcode == 0x9D){//Absolute X
-			set_absolute(cpu, cpu->X_reg, read, write, cpu->A_reg);
-			cpu->PC_reg += 3;
-			cpu->cycles += 5;
-		} else if(opcode == 0x99){//Absolute Y
-			set_absolute(cpu, cpu->Y_reg, read, write, cpu->A_reg);
-			cpu->PC_reg += 3;
-			cpu->cycles += 5;
-		} else if(opcode == 0x81){//Indirect X
-			set_indirect_X(cpu, read(cpu->PC_reg + 1), read, write, cpu->A_reg);
-			cpu->PC_reg += 2;
-			cpu->cycles += 6;
-		} else if(opcode == 0x91){//Indirect Y
-			set_indirect_Y(cpu, read(cpu->PC_reg + 1), read, write, cpu->A_reg);
-			cpu->PC_reg += 2;
-			cpu->cycles += 6;
-		}
-	//STX
-	} else if(opcode == 0x86 || opcode == 0x96 || opcode == 0x8E){
-		if(opcode == 0x86){//Zero page
-			write(read(cpu->PC_reg + 1), cpu->X_reg);
-			cpu->PC_reg += 2;
-			cpu->cycles += 3;
-		} else if(opcode == 0x96){//Zero page Y
-			write((read(cpu->PC_reg + 1) + cpu->Y_reg)&0xFF, cpu->X_reg);
-			cpu->PC_reg += 2;
-			cpu->cycles += 4;
-		} else if(opcode == 0x8E){//Absolute
-			set_absolute(cpu, 0, read, write, cpu->X_reg);
-			cpu->PC_reg += 3;
-			cpu->cycles += 4;
-		}
-	//STY
-	} else if(opcode == 0x84 || opcode == 0x94 || opcode == 0x8C){
-		if(opcode == 0x84){//Zero page
-			write(read(cpu->PC_reg + 1), cpu->Y_reg);
-			cpu->PC_reg += 2;
-			cpu->cycles += 3;
-		} else if(opcode == 0x94){//Zero page X
-			write((read(cpu->PC_reg + 1) + cpu->X_reg)&0xFF, cpu->Y_reg);
-			cpu->PC_reg += 2;
-			cpu->cycles += 4;
-		} else if(opcode == 0x8C){//Absolute
-			set_absolute(cpu, 0, read, write, cpu->Y_reg);
-			cpu->PC_reg += 3;
-			cpu->cycles += 4;
-		}
-	//TAX
-	} else if(opcode == 0xAA){
-		cpu->X_reg = cpu->A_reg;
-		cpu->PC_reg += 1;
-		cpu->cycles += 2;
-		
-		//Set the zero flag
-		if(!cpu->X_reg){
-			cpu->P_reg |= 1<<ZERO;
-		} else {
-			cpu->P_reg &= ~(1<<ZERO);
-		}
+	if(cpu->decode_cache){
+		return 1;
+	}
+	cache = calloc(1, sizeof(DECODE_CACHE));
+	if(!cache){
+		return 0;
+	}
+	cache->watcher = add_code_watcher(cpu->bus, decoded_code_written, cpu);
+	if(cache->watcher < 0){
+		free(cache);
+		return 0;
+	}
+	cpu->decode_cache = cache;
 
-		//Set the negative flag
-		if(cpu->X_reg&0x80){
-			cpu->P_reg |= 1<<NEGATIVE;
-		} else {
-			cpu->P_reg &= ~(1<<NEGATIVE);
-		}
-	//TAY
-	} else if(opcode == 0xA8){
-		cpu->Y_reg = cpu->A_reg;
-		cpu->PC_reg += 1;
-		cpu->cycles += 2;
-
-		//Set the zero flag
-		if(!cpu->Y_reg){
-			cpu->P_reg |= 1<<ZERO;
-		} else {
-			cpu->P_reg &= ~(1<<ZERO);
-		}
+	return 1;
+}
 
-		//Set the negative flag
-		if(cpu->Y_reg&0x80){
-			cpu->P_reg |= 1<<NEGATIVE;
-		} else {
-			cpu->P_reg &= ~(1<<NEGATIVE);
-		}
-	//TSX
-	} else if(opcode == 0xBA){
-		cpu->X_reg = cpu->SP_reg;
-		cpu->PC_reg += 1;
-		cpu->cycles += 2;
-
-		//Set the zero flag
-		if(!cpu->X_reg){
-			cpu->P_reg |= 1<<ZERO;
-		} else {
-			cpu->P_reg &= ~(1<<ZERO);
-		}
+void disable_decode_cache(CPU_6502 *cpu){
+	if(cpu->decode_cache){
+		remove_code_watcher(cpu->bus, cpu->decode_cache->watcher);
+		free(cpu->decode_cache);
+		cpu->decode_cache = NULL;
+	}
+}
 
-		//Set the negative flag
-		if(cpu->X_reg&0x80){
-			cpu->P_reg |= 1<<NEGATIVE;
-		} else {
-			cpu->P_reg &= ~(1<<NEGATIVE);
-		}
-	//TXA
-	} else if(opcode == 0x8A){
-		cpu->A_reg = cpu->X_reg;
-		cpu->PC_reg += 1;
-		cpu->cycles += 2;
-
-		//Set the zero flag
-		if(!cpu->A_reg){
-			cpu->P_reg |= 1<<ZERO;
-		} else {
-			cpu->P_reg &= ~(1<<ZERO);
-		}
+void flush_decode_cache(CPU_6502 *cpu){
+	DECODE_CACHE *cache = cpu->decode_cache;
+	unsigned int i;
 
-		//Set the negative flag
-		if(cpu->A_reg&0x80){
-			cpu->P_reg |= 1<<NEGATIVE;
-		} else {
-			cpu->P_reg &= ~(1<<NEGATIVE);
-		}
-	//TXS
-	} else if(opcode == 0x9A){
-		cpu->SP_reg = cpu->X_reg;
-		cpu->PC_reg += 1;
-		cpu->cycles += 2;
-	//TYA
-	} else if(opcode == 0x98){
-		cpu->A_reg = cpu->Y_reg;
-		cpu->PC_reg += 1;
-		cpu->cycles += 2;
-		
-		//Set the zero flag
-		if(!cpu->A_reg){
-			cpu->P_reg |= 1<<ZERO;
-		} else {
-			cpu->P_reg &= ~(1<<ZERO);
+	if(!cache){
+		return;
+	}
+	memset(cache->entries, 0, sizeof(cache->entries));
+	for(i = 0; i < 256; i++){
+		if(cpu->bus->code_pages[i]&(1<<cache->watcher)){
+			protect_code_page(cpu->bus, i, cache->watcher, 0);
 		}
+	}
+}
 
-		//Set the negative flag
-		if(cpu->A_reg&0x80){
-			cpu->P_reg |= 1<<NEGATIVE;
-		} else {
-			cpu->P_reg &= ~(1<<NEGATIVE);
-		}
-	//NOP
-	} else if(opcode == 0xEA){
-		cpu->PC_reg += 1;
-		cpu->cycles += 2;
-	//Unknown operation
+//Execute a single 6502 instruction, updating the state of the CPU
+//Traced accesses have to include the fetch of every instruction, so nothing decoded is used while tracing
+void execute_6502(CPU_6502 *cpu){
+	if(cpu->decode_cache && !cpu->bus->trace){
+		step_cached_6502(cpu);
 	} else {
-		printw("Error: Unknown operation 0x%x\n", (int) opcode);
-		exit(1);
+		step_6502(cpu);
 	}
 }
 
-void reset_6502(CPU_6502 *cpu, uint8_t (*read)(uint16_t)){
+//Execute instructions until cycle_budget cycles have passed or a device raises an event
+//At least one instruction is always executed. Returns the number of cycles taken.
+unsigned long long int run_6502(CPU_6502 *cpu, unsigned long long int cycle_budget){
+	unsigned long long int start_cycles;
+	unsigned long long int end_cycles;
+
+	start_cycles = cpu->cycles;
+	end_cycles = start_cycles + cycle_budget;
+	cpu->bus->event = 0;
+	if(cpu->decode_cache && !cpu->bus->trace){
+		do{
+			step_cached_6502(cpu);
+		} while(cpu->cycles < end_cycles && !cpu->bus->event);
+	} else {
+		do{
+			step_6502(cpu);
+		} while(cpu->cycles < end_cycles && !cpu->bus->event);
+	}
+
+	return cpu->cycles - start_cycles;
+}
+
+void reset_6502(CPU_6502 *cpu){
 	cpu->SP_reg -= 3;//This actually happens on the chip
-	cpu->PC_reg = ((uint16_t) read(0xFFFD))<<8 | read(0xFFFC);
+	cpu->PC_reg = ((uint16_t) bus_read(cpu->bus, 0xFFFD))<<8 | bus_read(cpu->bus, 0xFFFC);
 }
 
@@ -7,7 +7,11 @@
  * by Ben Jones
  */
 
+#ifndef CPU_H
+#define CPU_H
+
 #include <stdint.h>
+#include "bus.h"
 
 //Bits of the status register and correseponding flags
 #define CARRY 0
@@ -20,6 +24,59 @@
 
 typedef struct CPU_6502 CPU_6502;
 
+//Addressing modes
+#define IMPLIED 0
+#define IMMEDIATE 1
+#define ZERO_PAGE 2
+#define ZERO_PAGE_X 3
+#define ZERO_PAGE_Y 4
+#define ABSOLUTE 5
+#define ABSOLUTE_X 6
+#define ABSOLUTE_Y 7
+#define INDIRECT 8
+#define INDIRECT_X 9
+#define INDIRECT_Y 10
+#define RELATIVE 11
+
+typedef struct OPCODE OPCODE;
+
+//One entry of the decode table
+struct OPCODE{
+	//Carries out the operation on the effective address resolved by the addressing mode
+	void (*operation)(CPU_6502 *cpu, uint16_t address);
+	unsigned char mode;
+	//Base number of cycles the instruction takes
+	unsigned char cycles;
+	//Whether crossing a page while indexing costs an extra cycle
+	unsigned char page_penalty;
+};
+
+//Times a page's code may be rewritten before the decode cache stops keeping it
+#define DECODE_MAX_INVALIDATIONS 8
+
+typedef struct DECODED DECODED;
+
+//An instruction decoded once and kept until the memory it was read from changes
+struct DECODED{
+	void (*operation)(CPU_6502 *cpu, uint16_t address);
+	//The effective address if the addressing mode fixes it, otherwise the operand
+	uint16_t operand;
+	unsigned char mode;
+	unsigned char length;
+	unsigned char cycles;
+	unsigned char page_penalty;
+};
+
+typedef struct DECODE_CACHE DECODE_CACHE;
+
+struct DECODE_CACHE{
+	//Indexed by the address of the instruction. Entries without an operation haven't been decoded.
+	DECODED entries[0x10000];
+	unsigned int invalidations[256];
+	//Which of the bus's code watchers this is
+	int watcher;
+};
+
 //Store the state of cpu
 struct CPU_6502{
 	//The ALU loads and stores to and from the accumulator
@@ -31,11 +88,60 @@ struct CPU_6502{
 	uint8_t SP_reg;
 	uint16_t PC_reg;
 	//The bits status register are all of the processor flags, but it is its own register whose value can be pushed to the stack
+	//Its zero and negative bits are out of date, since those flags are worked out from nz_result only when something reads them
+	//Use get_status_6502 and set_status_6502 for the whole register
 	uint8_t P_reg;
+	//Result the zero and negative flags were last set from
+	//Zero is set if the low byte is 0, negative if bit 7 or bit 8 is set
+	uint16_t nz_result;
 	unsigned long long int cycles;
+	//Set when the CPU hits an opcode it doesn't know
+	unsigned char halted;
+	//Set while resolving an address if indexing crossed into the next page
+	unsigned char crossed_page;
+	//Where memory and devices are read and written
+	BUS *bus;
+	//Instructions already decoded, or NULL to decode each one every time
+	DECODE_CACHE *decode_cache;
 };
 
 
-void execute_6502(CPU_6502 *cpu, uint8_t (*read)(uint16_t), void (*write)(uint16_t, uint8_t));
+static inline int zero_flag_6502(const CPU_6502 *cpu){
+	return !(cpu->nz_result&0xFF);
+}
+
+static inline int negative_flag_6502(const CPU_6502 *cpu){
+	return (cpu->nz_result&0x180) != 0;
+}
+
+//The status register with every flag up to date, as PHP would push it
+uint8_t get_status_6502(const CPU_6502 *cpu);
+
+void set_status_6502(CPU_6502 *cpu, uint8_t status);
+
+//Number of bytes of each addressing mode, including the opcode
+extern const unsigned char mode_lengths[12];
+
+//Look up how the CPU carries out an opcode, for code that translates 6502 code ahead of running it
+//Returns NULL for opcodes the CPU doesn't know
+const OPCODE *decode_6502(uint8_t opcode);
+
+//Resolve the effective address of the instruction at PC
+uint16_t get_address(CPU_6502 *cpu, unsigned char mode);
+
+//Keep instructions read from RAM and ROM once they are decoded, until they are written over
+//Returns 0 if the cache couldn't be set up
+int enable_decode_cache(CPU_6502 *cpu);
+
+void disable_decode_cache(CPU_6502 *cpu);
+
+//Forget every decoded instruction, for when memory changed without going through the bus
+void flush_decode_cache(CPU_6502 *cpu);
+
+void execute_6502(CPU_6502 *cpu);
+
+unsigned long long int run_6502(CPU_6502 *cpu, unsigned long long int cycle_budget);
+
+void reset_6502(CPU_6502 *cpu);
 
-void reset_6502(CPU_6502 *cpu, uint8_t (*read)(uint16_t));
+#endif
@@ -0,0 +1,95 @@
+/*
+ * Apple 1 display
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include "display.h"
+#include "pace.h"
+#include "terminal.h"
+
+void display_init(DISPLAY *display, unsigned char slow){
+	display->length = 0;
+	display->dirty = 0;
+	display->last_frame_time = pace_now();
+	display->slow = slow;
+	display->ready_cycles = 0;
+	display->output = NULL;
+}
+
+//Pass the buffered text on to wherever output goes
+static void display_send(DISPLAY *display){
+	display->buffer[display->length] = (char) 0;
+	if(display->output){
+		fputs(display->buffer, display->output);
+	} else {
+		terminal->display(display->buffer);
+	}
+	display->length = 0;
+}
+
+static void display_output(DISPLAY *display, const char *text){
+	while(*text){
+		if(display->length == DISPLAY_BUFFER_SIZE - 1){
+			display_send(display);
+		}
+		display->buffer[display->length] = *text;
+		display->length++;
+		text++;
+	}
+	display->dirty = 1;
+}
+
+void display_write(DISPLAY *display, uint8_t value, unsigned long long int cycles){
+	char character[2];
+
+	if(display->slow){
+		//The character is dropped if the display is still busy, just like the real one
+		if(cycles < display->ready_cycles){
+			return;
+		}
+		display->ready_cycles = cycles + DISPLAY_CHARACTER_CYCLES;
+	}
+
+	if((value&0x7F) == '\n' || (value&0x7F) == '\r'){//Print \n instead of \r
+		display_output(display, "\n");
+	} else if((value&0x7F) == 0x5F){//Make the 0x5F character map to ASCII backspace
+		display_output(display, "\b \b");
+	} else if((value&0x7F) >= 0x20 && (value&0x7F) != 127){
+		//Output a character
+		character[0] = value&0x7F;
+		character[1] = (char) 0;
+		display_output(display, character);
+	}
+}
+
+uint8_t display_status(DISPLAY *display, unsigned long long int cycles){
+	if(display->slow && cycles < display->ready_cycles){
+		return 0x80;
+	}
+	return 0;
+}
+
+void display_flush(DISPLAY *display){
+	if(display->length){
+		display_send(display);
+	}
+	if(display->output){
+		fflush(display->output);
+	} else {
+		terminal->flush();
+	}
+	display->dirty = 0;
+	display->last_frame_time = pace_now();
+}
+
+void display_discard(DISPLAY *display){
+	display->length = 0;
+	display->dirty = 0;
+}
+
+void display_update(DISPLAY *display){
+	if(display->dirty && pace_now() - display->last_frame_time >= 1000000000LL/DISPLAY_FRAME_RATE){
+		display_flush(display);
+	}
+}
@@ -0,0 +1,55 @@
+/*
+ * Apple 1 display
+ *
+ * Characters written to the display register are collected in a buffer
+ * and handed to the terminal at most DISPLAY_FRAME_RATE times a second,
+ * instead of the terminal being refreshed after every instruction.
+ */
+
+#ifndef DISPLAY_H
+#define DISPLAY_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#define DISPLAY_BUFFER_SIZE 4096
+
+#define DISPLAY_FRAME_RATE 60
+
+//The real display takes one frame of its 60 Hz refresh to accept each character
+#define DISPLAY_CHARACTER_CYCLES 16667
+
+typedef struct DISPLAY DISPLAY;
+
+struct DISPLAY{
+	char buffer[DISPLAY_BUFFER_SIZE];
+	unsigned int length;
+	//Whether anything has been output since the terminal was last refreshed
+	unsigned char dirty;
+	long long int last_frame_time;
+	//Where output goes instead of the terminal, if set
+	FILE *output;
+	//Make the display as slow to accept characters as the real one
+	unsigned char slow;
+	//Cycle at which the display will accept the next character
+	unsigned long long int ready_cycles;
+};
+
+void display_init(DISPLAY *display, unsigned char slow);
+
+//A byte written to the display register
+void display_write(DISPLAY *display, uint8_t value, unsigned long long int cycles);
+
+//Value of the display register: bit 7 is set while the display is busy
+uint8_t display_status(DISPLAY *display, unsigned long long int cycles);
+
+//Refresh the terminal if something changed and a frame has passed
+void display_update(DISPLAY *display);
+
+//Hand everything buffered to the terminal and refresh it now
+void display_flush(DISPLAY *display);
+
+//Throw away output that hasn't reached the terminal yet
+void display_discard(DISPLAY *display);
+
+#endif
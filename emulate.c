@@ -3,254 +3,333 @@
 #include <string.h>
 #include <time.h>
 #include "cpu.h"
+#include "bus.h"
+#include "pace.h"
+#include "terminal.h"
+#include "display.h"
+#include "keyboard.h"
+#include "tape.h"
+#include "machine.h"
+#include "server.h"
+#include "batch.h"
 
-#ifdef _WIN32
+//Longest BASIC may take to start when building the boot snapshot
+#define BOOT_CYCLE_LIMIT 10000000
 
-#include <curses.h>
+//Number of cycles the CPU runs between servicing the host: 10 ms at 1 MHz
+#define SLICE_CYCLES 10000
 
-#else
+//Slice length when running unthrottled
+#define TURBO_SLICE_CYCLES 1000000
 
-#include <ncurses.h>
-
-void Sleep(long int msec){
-	struct timespec sleep_time;
-
-	sleep_time.tv_sec = msec/1000;
-	sleep_time.tv_nsec = (msec%1000)*1000000;
-	nanosleep(&sleep_time, NULL);
-}
-
-#endif
-
-unsigned char DEBUG_STEP = 0;
-
-uint8_t memory[0x10000];
-
-uint32_t tape[0x100000];
-
-uint32_t tape_index;
+MACHINE machine;
 
 char str_buffer[256];
 
-unsigned char next_tape_index;
+void print_state(CPU_6502 cpu){
+	term_printf("A: %02x X:%02x Y:%02x SP:%02x P:%02x PC:%02x\n", (int) cpu.A_reg, (int) cpu.X_reg, (int) cpu.Y_reg, (int) cpu.SP_reg, (int) get_status_6502(&cpu), (int) cpu.PC_reg);
+	term_printf("\nNext: %02x %02x %02x\n", (int) machine.memory[cpu.PC_reg], (int) machine.memory[cpu.PC_reg + 1], (int) machine.memory[cpu.PC_reg + 2]);
+}
 
-unsigned char tape_active;
+void load_tape(char *file_name){
+	term_printf("Reading from tape file named \"%s\"\n", file_name);
+	if(!tape_load(&machine.tape, file_name, CLOCK_RATE)){
+		term_printf("file error\n");
+	}
+}
 
-unsigned char tape_writing;
+void store_tape(char *file_name){
+	term_printf("Storing tape to file named \"%s\"\n", file_name);
+	if(!tape_store(&machine.tape, file_name, CLOCK_RATE)){
+		term_printf("file error\n");
+	}
+}
 
-unsigned char tape_reading;
+void save_snapshot(char *file_name){
+	term_printf("Saving snapshot to file named \"%s\"\n", file_name);
+	if(!machine_save_snapshot(&machine, file_name)){
+		term_printf("file error\n");
+	}
+}
 
-unsigned char current_tape_value;
+//Returns 0 if the snapshot couldn't be loaded
+int load_snapshot(char *file_name){
+	term_printf("Loading snapshot from file named \"%s\"\n", file_name);
+	if(!machine_load_snapshot(&machine, file_name)){
+		term_printf("file error\n");
+		return 0;
+	}
 
-void print_state(CPU_6502 cpu){
-	printw("A: %02x X:%02x Y:%02x SP:%02x P:%02x PC:%02x\n", (int) cpu.A_reg, (int) cpu.X_reg, (int) cpu.Y_reg, (int) cpu.SP_reg, (int) cpu.P_reg, (int) cpu.PC_reg);
-	printw("\nNext: %02x %02x %02x\n", (int) memory[cpu.PC_reg], (int) memory[cpu.PC_reg + 1], (int) memory[cpu.PC_reg + 2]);
+	return 1;
 }
 
-void load_tape(char *file_name){
+//Start BASIC and run until it waits for input, or pick up where that left off last time
+void boot_basic(){
+	const char *command = "E000R\r";
+	char file_name[32];
+	unsigned long long int cycle_limit;
 	FILE *fp;
+
+	sprintf(file_name, "boot-%08lx.snap", (unsigned long) machine_rom_checksum(&machine));
 	fp = fopen(file_name, "rb");
-	printw("Reading from tape file named \"%s\"\n", file_name);
-	if(fp && fread(tape, 4, 0x100000, fp) == 0x100000){
+	if(fp){
 		fclose(fp);
-	} else {
-		printw("file error\n");
-		if(fp){
-			fclose(fp);
+		if(load_snapshot(file_name)){
+			return;
 		}
 	}
 
-	return;
-}
+	//Nothing is shown, just as when starting from the snapshot
+	while(*command){
+		keyboard_push(&machine.keyboard, *command|0x80);
+		command++;
+	}
+	cycle_limit = machine.cpu.cycles + BOOT_CYCLE_LIMIT;
+	while(!machine.keyboard.idle && !machine.cpu.halted && machine.cpu.cycles < cycle_limit){
+		machine_run(&machine, TURBO_SLICE_CYCLES);
+	}
+	display_discard(&machine.display);
 
-void store_tape(char *file_name){
-	FILE *fp;
-	printw("Storing tape to file named \"%s\"\n", file_name);
-	fp = fopen(file_name, "wb");
-	if(fp && fwrite(tape, 4, 0x100000, fp) == 0x100000){
-		fclose(fp);
+	if(machine.keyboard.idle){
+		save_snapshot(file_name);
 	} else {
-		printw("file error\n");
-		if(fp){
-			fclose(fp);
-		}
+		term_printf("BASIC didn't finish starting\n");
 	}
 }
 
-//Special read memory routine for memory-mapped I/O
-uint8_t read_mem(uint16_t index){
-	uint8_t output;
+//Decode the next block on the tape straight into memory instead of letting the ACI read it
+void fast_load_tape(char *range){
+	unsigned int start;
+	unsigned int end;
+	uint32_t count;
+	uint16_t checksum;
 
-	if(DEBUG_STEP){
-		printw("READ: %04x ", index);
+	if(sscanf(range, "%x%*[ .]%x", &start, &end) != 2 || start > end || end > 0xFFFF){
+		term_printf("Usage: tfast START END\n");
+		return;
 	}
-	
-	if(tape_writing && index >= 0xC000 && index <= 0xC0FF){
-		next_tape_index = 1;
-	} else if(index >= 0xC081 && index <= 0xC0FF){
-		if(current_tape_value){
-			output = memory[index];
-		} else {
-			output = memory[index&0xFFFE];
-		}
-	} else {
-		output = memory[index];
+	if(!machine_is_ram(&machine, start, end)){
+		term_printf("Can only load into RAM\n");
+		return;
 	}
 
-	if(index == 0xD010){
-		memory[0xD011] &= 0x7F;
-	} else if((index&0xFF0F) == 0xD002){
-		output = 0;
+	count = machine_fast_load(&machine, start, end, &checksum);
+	if(!count){
+		term_printf("No data found on tape\n");
+		return;
 	}
-	if(DEBUG_STEP){
-		printw("%02x\n", memory[index]);
+	term_printf("Loaded %04X.%04X checksum %04X\n", start, start + count - 1, (unsigned int) checksum);
+	if(count < end - start + 1){
+		term_printf("Tape ran out after %u bytes\n", count);
 	}
-	return output;
 }
 
-//Special write memory routine for memory mapped I/O
-void write_mem(uint16_t index, uint8_t value){
-	uint8_t x;
-	uint8_t y;
-
-	if(DEBUG_STEP){
-		printw("WRITE: %02x --> %04x\n", value, index);
-	}
-	if((index&0xFF0F) == 0xD002){
-		if((value&0x7F) == '\n' || (value&0x7F) == '\r'){//Print \n instead of \r
-			printw("\n");
-		} else if((value&0x7F) == 0x5F){//Make the 0x5F character map to ASCII backspace
-			printw("\b \b");
-		} else if((value&0x7F) >= 0x20 && (value&0x7F) != 127){
-			//Output a character
-			printw("%c", value&0x7F);
-		}
-	}
-	memory[index] = value;
+void print_usage(char *program_name){
+	fprintf(stderr, "Usage: %s [options]\n", program_name);
+	fprintf(stderr, "  -s, --speed N   Run at N times the speed of the Apple 1\n");
+	fprintf(stderr, "  -t, --turbo     Run as fast as possible\n");
+	fprintf(stderr, "  --jit           Translate hot code to native code where the host allows\n");
+	fprintf(stderr, "  --stats         Report the effective clock rate on stderr every second\n");
+	fprintf(stderr, "  --headless      Use stdin and stdout instead of a curses screen\n");
+	fprintf(stderr, "  -c, --cycles N  Quit after running N cycles\n");
+	fprintf(stderr, "  --slow-display  Output characters at the speed of the real display\n");
+	fprintf(stderr, "  --bridge        Let programs load and save host files through page 0xC2\n");
+	fprintf(stderr, "  --boot-basic    Start in BASIC from a snapshot cached for the ROMs\n");
+	fprintf(stderr, "  --serve SOCKET  Boot once, then run a headless clone for each connection\n");
+	fprintf(stderr, "  --batch FILE    Run the jobs listed in a manifest on a pool of threads\n");
+	fprintf(stderr, "  --threads N     Threads for --batch, one per processor by default\n");
+	fprintf(stderr, "  --load-snapshot FILE  Start from a saved snapshot instead of a reset\n");
+	fprintf(stderr, "  --save-snapshot FILE  Save a snapshot when the emulator exits\n");
 }
 
-int main(){
-	CPU_6502 cpu;
-	FILE *fp;
-	int key_hit;
-	unsigned int count = 0;
+int main(int argc, char **argv){
 	char temp_char;
 	unsigned char str_index;
-	unsigned long long int last_cycles;
-	unsigned char last_cycle_diff;
-	unsigned long long int last_time;
-	struct timespec current_time;
-	unsigned long long int next_time;
-
-	cpu.A_reg = 0;
-	cpu.X_reg = 0;
-	cpu.Y_reg = 0;
-	cpu.SP_reg = 0;
-	cpu.P_reg = 0;
-	cpu.PC_reg = 0xE000;
-	tape_writing = 0;
-	tape_reading = 0;
-
-	initscr();
-	cbreak();
-	noecho();
-	scrollok(stdscr, 1);
+	PACER pacer;
+	unsigned long long int clock_rate = CLOCK_RATE;
+	unsigned long long int slice_cycles = SLICE_CYCLES;
+	unsigned char show_stats = 0;
+	unsigned char use_jit = 0;
+	unsigned char slow_display = 0;
+	unsigned char enable_bridge = 0;
+	char *load_snapshot_name = NULL;
+	unsigned char boot_into_basic = 0;
+	char *socket_path = NULL;
+	char *manifest_name = NULL;
+	unsigned int num_threads = 0;
+	char *save_snapshot_name = NULL;
+	unsigned long long int cycle_limit = 0;
+	int exit_status = 0;
+	double speed;
+	int i;
+
+	for(i = 1; i < argc; i++){
+		if((!strcmp(argv[i], "-s") || !strcmp(argv[i], "--speed")) && i + 1 < argc){
+			i++;
+			speed = atof(argv[i]);
+			if(speed <= 0){
+				fprintf(stderr, "Invalid speed \"%s\"\n", argv[i]);
+				exit(1);
+			}
+			clock_rate = CLOCK_RATE*speed;
+			slice_cycles = SLICE_CYCLES*speed;
+			if(!slice_cycles){
+				slice_cycles = 1;
+			}
+		} else if(!strcmp(argv[i], "-t") || !strcmp(argv[i], "--turbo")){
+			clock_rate = 0;
+			slice_cycles = TURBO_SLICE_CYCLES;
+		} else if(!strcmp(argv[i], "--jit")){
+			use_jit = 1;
+		} else if(!strcmp(argv[i], "--stats")){
+			show_stats = 1;
+		} else if(!strcmp(argv[i], "--slow-display")){
+			slow_display = 1;
+		} else if(!strcmp(argv[i], "--bridge")){
+			enable_bridge = 1;
+		} else if(!strcmp(argv[i], "--serve") && i + 1 < argc){
+			i++;
+			socket_path = argv[i];
+			terminal = &headless_terminal;
+		} else if(!strcmp(argv[i], "--batch") && i + 1 < argc){
+			i++;
+			manifest_name = argv[i];
+		} else if(!strcmp(argv[i], "--threads") && i + 1 < argc){
+			i++;
+			num_threads = atoi(argv[i]);
+		} else if(!strcmp(argv[i], "--boot-basic")){
+			boot_into_basic = 1;
+		} else if(!strcmp(argv[i], "--load-snapshot") && i + 1 < argc){
+			i++;
+			load_snapshot_name = argv[i];
+		} else if(!strcmp(argv[i], "--save-snapshot") && i + 1 < argc){
+			i++;
+			save_snapshot_name = argv[i];
+		} else if(!strcmp(argv[i], "--headless")){
+			terminal = &headless_terminal;
+		} else if((!strcmp(argv[i], "-c") || !strcmp(argv[i], "--cycles")) && i + 1 < argc){
+			i++;
+			cycle_limit = strtoull(argv[i], NULL, 0);
+		} else {
+			print_usage(argv[0]);
+			exit(1);
+		}
+	}
+
+	//Batch jobs bring their own machines and never touch the terminal
+	if(manifest_name){
+		exit(run_batch(manifest_name, num_threads, show_stats, use_jit));
+	}
+
+	terminal->start();
+	machine_init(&machine, slow_display);
+	if(use_jit && !machine_enable_jit(&machine)){
+		term_printf("The JIT isn't supported on this host, interpreting instead\n");
+	}
+	machine.cpu.A_reg = 0;
+	machine.cpu.X_reg = 0;
+	machine.cpu.Y_reg = 0;
+	machine.cpu.SP_reg = 0;
+	set_status_6502(&machine.cpu, 0);
+	machine.cpu.PC_reg = 0xE000;
 
 	//Load Integer Basic
-	fp = fopen("BASIC", "rb");
-	if(fp && fread(memory + 0xE000, 1, 0x1000, fp) == 0x1000){
-		fclose(fp);
+	if(machine_load_rom(&machine, "BASIC", 0xE000, 0x1000)){
+		machine.basic_loaded = 1;
 	} else {
-		if(fp){
-			fclose(fp);
+		term_printf("Warning: could not load file named \"BASIC\".\nStarting without apple 1 BASIC loaded.\nApple 1 basic can still be loaded from a cassette file into address 0xE000.\n---\n");
+		if(terminal->interactive){
+			term_printf("Press any key to continue...\n");
+			terminal->wait_key();
+			terminal->clear();
 		}
-		printw("Warning: could not load file named \"BASIC\".\nStarting without apple 1 BASIC loaded.\nApple 1 basic can still be loaded from a cassette file into address 0xE000.\n---\n");
-		printw("Press any key to continue...\n");
-		getch();
-		clear();
 	}
 	
 	//Load Woz's ACI
-	fp = fopen("WOZACI", "rb");
-	if(fp && fread(memory + 0xC000, 1, 0x100, fp) == 0x100){
-		fclose(fp);
-	} else {
-		if(fp){
-			fclose(fp);
-		}
-		fprintf(stderr, "Could not load WOZACI due to file error\n");
+	if(!machine_load_rom(&machine, "WOZACI", 0xC000, 0x100)){
+		term_printf("Could not load WOZACI due to file error\n");
+		terminal->stop();
 		exit(1);
 	}
 
-	memcpy(memory + 0xC100, memory + 0xC000, 0x100);
-
 	//Load Woz's monitor
-	fp = fopen("WOZMON", "rb");
-	if(fp && fread(memory + 0xFF00, 1, 0x100, fp) == 0x100){
-		fclose(fp);
-	} else {
-		if(fp){
-			fclose(fp);
+	if(!machine_load_rom(&machine, "WOZMON", 0xFF00, 0x100)){
+		term_printf("Could not load WOZMON due to file error\n");
+		terminal->stop();
+		exit(1);
+	}
+	machine_map(&machine, enable_bridge);
+	machine_reset(&machine);//Reset the cpu
+	if(load_snapshot_name){
+		if(!load_snapshot(load_snapshot_name)){
+			terminal->stop();
+			exit(1);
+		}
+	} else if(boot_into_basic){
+		if(machine.basic_loaded){
+			boot_basic();
+		} else {
+			term_printf("Can't boot into BASIC without the BASIC ROM\n");
 		}
-		fprintf(stderr, "Could not load WOZMON due to file error\n");
+	}
+
+	//Everything from here on happens in a clone for each job
+	if(socket_path && !serve(socket_path)){
+		terminal->stop();
 		exit(1);
 	}
-	reset_6502(&cpu, read_mem);//Reset the cpu
-	cpu.cycles = 0;
-	last_cycles = 0;
 	
 	//Initialize the timing
-	clock_gettime(CLOCK_MONOTONIC, &current_time);
-	last_time = 0;
-	last_cycle_diff = 0;
-	next_tape_index = 0;
-	nodelay(stdscr, 1);
+	pace_start(&pacer, clock_rate, machine.cpu.cycles);
 	while(1){
-		/* Limit the speed of the processor
-		 * based on how many cycles the last
-		 * instruction took. The 6502 on the
-		 * Apple 1 was clocked at 1 MHz.
-		 */
-		if(!DEBUG_STEP){
-			last_time += last_cycle_diff;
-			if(last_time > 1000){
-				Sleep(last_time/1000);
-				last_time -= 1000;
+		//Execute a time slice, or a single instruction while debugging
+		if(machine.debug_step){
+			machine_run(&machine, 1);
+		} else {
+			machine_run(&machine, slice_cycles);
+			//Limit the speed of the processor to real time
+			if(pace(&pacer, machine.cpu.cycles) && show_stats){
+				fprintf(stderr, "%.3f MHz\n", pacer.effective_rate/1000000.0);
 			}
 		}
 
-		//Execute the instruction
-		execute_6502(&cpu, read_mem, write_mem);
-		count = count + 1;
+		if(machine.cpu.halted){
+			term_printf("Error: Unknown operation 0x%x\n", (int) machine.memory[machine.cpu.PC_reg]);
+			exit_status = 1;
+			break;
+		}
+		if(cycle_limit && machine.cpu.cycles >= cycle_limit){
+			break;
+		}
 		
 		//Debugging I/O
-		if(DEBUG_STEP){
-			memset(str_buffer, 256, 0);
-			echo();
-			getstr(str_buffer);
-			noecho();
+		if(machine.debug_step){
+			display_flush(&machine.display);
+			memset(str_buffer, 0, sizeof(str_buffer));
+			//With no more commands coming, carry on running until the program waits for input
+			if(!terminal->get_line(str_buffer, sizeof(str_buffer))){
+				machine.keyboard.input_ended = 1;
+				machine_set_debug(&machine, 0);
+				pace_start(&pacer, clock_rate, machine.cpu.cycles);
+				continue;
+			}
 			temp_char = str_buffer[6];
 			str_buffer[6] = (char) 0;
 
 			if(!strcmp(str_buffer, "resume")){
-				DEBUG_STEP = 0;
-				clock_gettime(CLOCK_MONOTONIC, &current_time);
-				last_time = 0;
-				nodelay(stdscr, 1);
+				machine_set_debug(&machine, 0);
+				pace_start(&pacer, clock_rate, machine.cpu.cycles);
 			} else if(temp_char == ' ' && !strcmp(str_buffer, "tstart")){
-				tape_active = 1;
 				str_buffer[12] = (char) 0;
 				if(temp_char == ' ' && !strcmp(str_buffer + 7, "write")){
-					tape_writing = 1;
-					printw("WRITING TO TAPE\n");
+					machine_start_tape(&machine, 1);
+					term_printf("WRITING TO TAPE\n");
 				}
 				str_buffer[11] = (char) 0;
 				if(temp_char == ' ' && !strcmp(str_buffer + 7, "read")){
-					tape_reading = 1;
-					current_tape_value = 0;
-					printw("READING FROM TAPE\n");
+					machine_start_tape(&machine, 0);
+					term_printf("READING FROM TAPE\n");
 				}
-				tape_index = 0;
 			} else if(temp_char == ' ' && !strcmp(str_buffer, "tstore")){
 				str_index = 0;
 				while(str_buffer[str_index] != '\n' && str_index < 255){
@@ -265,13 +344,17 @@ int main(){
 			str_buffer[5] = (char) 0;
 
 			if(!strcmp(str_buffer, "tstop")){
-				tape_active = 0;
-				tape_writing = 0;
-				tape_reading = 0;
+				machine_stop_tape(&machine);
 			} else if(!strcmp(str_buffer, "reset")){
-				reset_6502(&cpu, read_mem);
+				reset_6502(&machine.cpu);
 			} else if(!strcmp(str_buffer, "quit")){
 				break;
+			} else if(!strcmp(str_buffer, "speed")){
+				term_printf("Running at %.3f MHz\n", pacer.effective_rate/1000000.0);
+			}
+
+			if(temp_char == ' ' && !strcmp(str_buffer, "tfast")){
+				fast_load_tape(str_buffer + 6);
 			}
 
 			if(temp_char == ' ' && !strcmp(str_buffer, "tload")){
@@ -283,79 +366,48 @@ int main(){
 				load_tape(str_buffer + 6);
 			}
 
+			str_buffer[5] = temp_char;
+			if(!strncmp(str_buffer, "snapshot save ", 14)){
+				save_snapshot(str_buffer + 14);
+			} else if(!strncmp(str_buffer, "snapshot load ", 14)){
+				load_snapshot(str_buffer + 14);
+			}
+
 			if(str_buffer[0] != (char) 0 && str_buffer[1] == (char) 0){
-				memory[0xD010] = str_buffer[0]|0x80;
-				memory[0xD011] |= 0x80;
+				keyboard_push(&machine.keyboard, str_buffer[0]|0x80);
 			}
 		}
 
-		//Handle keyboard I/O
-		if(!(count%200) && (key_hit = getch()) != ERR){
-			if(key_hit == 0x08 || key_hit == 0x7F){//Emulate the backspace character
-				memory[0xD010] = 0xDF;
-				memory[0xD011] |= 0x80;
-			} else if(key_hit == '~'){//Emulate the control character
-				nodelay(stdscr, 0);
-				key_hit = getch();
-				nodelay(stdscr, 1);
-				if(key_hit == 'd' || key_hit == 'D'){//Ctrl-D
-					memory[0xD010] = 0x84;
-					memory[0xD011] |= 0x80;
-				} else if(key_hit == 'g' || key_hit == 'G'){//Ctrl-G (bell character)
-					memory[0xD010] = 0x87;
-					memory[0xD011] |= 0x80;
-				} else if(key_hit == '`'){//Escape
-					memory[0xD010] = 0x9B;
-					memory[0xD011] |= 0x80;
-				}
-			} else if(key_hit == '|'){
-				DEBUG_STEP = 1;
-				printw("\n");
-				nodelay(stdscr, 0);
-			} else {
-				//Convert lower case characters to upper case
-				if(key_hit >= 'a' && key_hit <= 'z'){
-					key_hit += 'A' - 'a';
-				}
-
-				//Replace \n with \r
-				if(key_hit == '\n'){
-					key_hit = '\r';
-				}
-
-				memory[0xD010] = key_hit|0x80;
-				memory[0xD011] |= 0x80;
+		//Sleep while the program waits for a key that isn't coming yet
+		if(!machine.debug_step && machine.keyboard.idle){
+			if(machine.keyboard.input_ended){
+				break;
 			}
+			display_flush(&machine.display);
+			machine.cpu.cycles += keyboard_wait_idle(&machine.keyboard, clock_rate);
 		}
 
-		last_cycle_diff = cpu.cycles - last_cycles;
-
-		//Handle tape
-		if(tape_active && tape_reading){
-			while(last_cycles < cpu.cycles){
-				if(!tape[tape_index]){
-					tape_index++;
-					current_tape_value = !current_tape_value;
-				}
-				tape[tape_index] -= 1;
-				last_cycles++;
-			}
-		} else if(tape_active && tape_writing){
-			tape[tape_index] += cpu.cycles - last_cycles;
-			if(next_tape_index){
-				tape_index++;
-				next_tape_index = 0;
-			}
-			last_cycles = cpu.cycles;
-		} else {
-			last_cycles = cpu.cycles;
+		//Handle keyboard I/O
+		if(!machine.debug_step && keyboard_poll(&machine.keyboard) == KEYBOARD_DEBUG){
+			machine_set_debug(&machine, 1);
+			display_flush(&machine.display);
+			term_printf("\n");
 		}
-		refresh();
+
+		display_update(&machine.display);
 	}
 
-	printw("Press any key to exit...\n");
-	nodelay(stdscr, 0);
-	getch();
+	display_flush(&machine.display);
+
+	if(save_snapshot_name){
+		save_snapshot(save_snapshot_name);
+	}
+
+	terminal->stop();
+
+	if(show_stats){
+		fprintf(stderr, "Ran %llu cycles\n", machine.cpu.cycles);
+	}
 
-	endwin();
+	return exit_status;
 }
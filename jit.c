@@ -0,0 +1,377 @@
+/*
+ * Dynamic recompiler for x86-64
+ */
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "jit.h"
+
+#if defined(__x86_64__) && !defined(_WIN32)
+#define JIT_SUPPORTED
+#include <sys/mman.h>
+#endif
+
+#ifdef JIT_SUPPORTED
+
+//Most bytes of x86 one translated instruction takes, including an early return
+#define JIT_MAX_INSTRUCTION_CODE 96
+//Prologue and epilogue of a block
+#define JIT_BLOCK_OVERHEAD 32
+
+static void emit_byte(JIT *jit, uint8_t value){
+	jit->code[jit->code_used] = value;
+	jit->code_used++;
+}
+
+static void emit_bytes(JIT *jit, const uint8_t *values, unsigned int length){
+	memcpy(jit->code + jit->code_used, values, length);
+	jit->code_used += length;
+}
+
+//x86 is little endian, like the 6502
+static void emit_value(JIT *jit, uint64_t value, unsigned int length){
+	while(length){
+		emit_byte(jit, value&0xFF);
+		value >>= 8;
+		length--;
+	}
+}
+
+//The generated code keeps the CPU in rbx and the two exit flags in r12 and r13, all saved across calls
+static void emit_prologue(JIT *jit){
+	//push rbx; push r12; push r13; mov rbx, rdi; mov r12, rsi; mov r13, rdx
+	static const uint8_t prologue[] = {0x53, 0x41, 0x54, 0x41, 0x55, 0x48, 0x89, 0xFB, 0x49, 0x89, 0xF4, 0x49, 0x89, 0xD5};
+
+	emit_bytes(jit, prologue, sizeof(prologue));
+}
+
+static void emit_epilogue(JIT *jit){
+	//pop r13; pop r12; pop rbx; ret
+	static const uint8_t epilogue[] = {0x41, 0x5D, 0x41, 0x5C, 0x5B, 0xC3};
+
+	emit_bytes(jit, epilogue, sizeof(epilogue));
+}
+
+//mov word [rbx + offset of PC_reg], pc
+static void emit_set_pc(JIT *jit, uint16_t pc){
+	emit_bytes(jit, (const uint8_t []) {0x66, 0xC7, 0x83}, 3);
+	emit_value(jit, offsetof(CPU_6502, PC_reg), 4);
+	emit_value(jit, pc, 2);
+}
+
+//mov rdi, rbx; mov rax, function; call rax
+static void emit_call(JIT *jit, void *function){
+	emit_bytes(jit, (const uint8_t []) {0x48, 0x89, 0xDF, 0x48, 0xB8}, 5);
+	emit_value(jit, (uintptr_t) function, 8);
+	emit_bytes(jit, (const uint8_t []) {0xFF, 0xD0}, 2);
+}
+
+//add qword [rbx + offset of cycles], cycles
+static void emit_add_cycles(JIT *jit, uint8_t cycles){
+	emit_bytes(jit, (const uint8_t []) {0x48, 0x83, 0x83}, 3);
+	emit_value(jit, offsetof(CPU_6502, cycles), 4);
+	emit_byte(jit, cycles);
+}
+
+//Return if a device raised an event or the code being run was overwritten
+static void emit_exit_check(JIT *jit){
+	//mov al, [r12]; or al, [r13]; jz past the epilogue
+	emit_bytes(jit, (const uint8_t []) {0x41, 0x8A, 0x04, 0x24, 0x41, 0x0A, 0x45, 0x00, 0x74, 0x06}, 10);
+	emit_epilogue(jit);
+}
+
+static int ends_block(uint8_t opcode){
+	switch(opcode){
+		//BRK, JSR, RTI, RTS and JMP
+		case 0x00:
+		case 0x20:
+		case 0x40:
+		case 0x60:
+		case 0x4C:
+		case 0x6C:
+		//Branches
+		case 0x10:
+		case 0x30:
+		case 0x50:
+		case 0x70:
+		case 0x90:
+		case 0xB0:
+		case 0xD0:
+		case 0xF0:
+			return 1;
+		default:
+			return 0;
+	}
+}
+
+static int touches_memory(uint8_t opcode, const OPCODE *op){
+	switch(op->mode){
+		case IMMEDIATE:
+		case RELATIVE:
+			return 0;
+		case IMPLIED:
+			//PHP, PLP, PHA and PLA use the stack
+			return opcode == 0x08 || opcode == 0x28 || opcode == 0x48 || opcode == 0x68;
+		default:
+			return 1;
+	}
+}
+
+static void emit_instruction(JIT *jit, uint16_t pc, uint8_t opcode, const OPCODE *op){
+	uint16_t next_pc;
+	uint16_t address;
+	unsigned char constant_address;
+
+	next_pc = pc + mode_lengths[op->mode];
+	constant_address = 1;
+	switch(op->mode){
+		case IMMEDIATE:
+			address = pc + 1;
+			break;
+		case ZERO_PAGE:
+			address = bus_read(jit->bus, pc + 1);
+			break;
+		case ABSOLUTE:
+			address = bus_read(jit->bus, pc + 1) | ((uint16_t) bus_read(jit->bus, pc + 2))<<8;
+			break;
+		case RELATIVE:
+			address = next_pc + (int8_t) bus_read(jit->bus, pc + 1);
+			break;
+		case IMPLIED:
+			address = 0;
+			break;
+		default:
+			//Depends on the registers or memory, so the interpreter's code works it out at run time
+			constant_address = 0;
+			address = 0;
+			emit_set_pc(jit, pc);
+			//mov esi, mode
+			emit_byte(jit, 0xBE);
+			emit_value(jit, op->mode, 4);
+			emit_call(jit, (void *) get_address);
+			break;
+	}
+
+	emit_set_pc(jit, next_pc);
+	if(constant_address){
+		//mov esi, address
+		emit_byte(jit, 0xBE);
+		emit_value(jit, address, 4);
+	} else {
+		//movzx esi, ax
+		emit_bytes(jit, (const uint8_t []) {0x0F, 0xB7, 0xF0}, 3);
+	}
+	emit_call(jit, (void *) op->operation);
+	emit_add_cycles(jit, op->cycles);
+	if(op->page_penalty){
+		//movzx eax, byte [rbx + offset of crossed_page]; add [rbx + offset of cycles], rax
+		emit_bytes(jit, (const uint8_t []) {0x0F, 0xB6, 0x83}, 3);
+		emit_value(jit, offsetof(CPU_6502, crossed_page), 4);
+		emit_bytes(jit, (const uint8_t []) {0x48, 0x01, 0x83}, 3);
+		emit_value(jit, offsetof(CPU_6502, cycles), 4);
+	}
+	if(touches_memory(opcode, op)){
+		emit_exit_check(jit);
+	}
+}
+
+static void make_code_writable(JIT *jit, unsigned char writable){
+	mprotect(jit->code, JIT_CODE_SIZE, writable ? PROT_READ | PROT_WRITE : PROT_READ | PROT_EXEC);
+}
+
+static int can_translate(JIT *jit, unsigned int address){
+	return address <= 0xFFFF && jit->bus->read_pages[address>>8] && jit->invalidations[address>>8] < JIT_MAX_INVALIDATIONS;
+}
+
+//A write to a page holding translated code drops every block the page is part of
+static void code_written(void *context, uint16_t address){
+	JIT *jit = context;
+	JIT_BLOCK *block;
+	uint8_t page;
+	unsigned int i;
+
+	page = address>>8;
+	for(i = 0; i < jit->num_blocks; i++){
+		block = jit->blocks + i;
+		if(block->live && block->first_page <= page && block->last_page >= page){
+			jit->entries[block->start] = NULL;
+			block->live = 0;
+		}
+	}
+	protect_code_page(jit->bus, page, jit->watcher, 0);
+	jit->invalidations[page]++;
+	jit->exit = 1;
+}
+
+//Translate the block starting at start. Returns 0 if nothing there can be translated.
+static int translate_block(JIT *jit, uint16_t start){
+	JIT_BLOCK_CODE code;
+	JIT_BLOCK *block;
+	const OPCODE *op;
+	unsigned int pc;
+	unsigned int end;
+	unsigned int num_instructions;
+	unsigned int max_cycles;
+	unsigned int page;
+	uint8_t opcode;
+
+	if(!can_translate(jit, start)){
+		return 0;
+	}
+	if(jit->num_blocks == JIT_MAX_BLOCKS || JIT_CODE_SIZE - jit->code_used < JIT_BLOCK_OVERHEAD + JIT_MAX_BLOCK_INSTRUCTIONS*JIT_MAX_INSTRUCTION_CODE){
+		jit_flush(jit);
+	}
+
+	make_code_writable(jit, 1);
+	code = (JIT_BLOCK_CODE) (jit->code + jit->code_used);
+	emit_prologue(jit);
+	pc = start;
+	end = start;
+	num_instructions = 0;
+	max_cycles = 0;
+	while(num_instructions < JIT_MAX_BLOCK_INSTRUCTIONS){
+		opcode = bus_read(jit->bus, pc);
+		op = decode_6502(opcode);
+		if(!op || !can_translate(jit, pc + mode_lengths[op->mode] - 1)){
+			break;
+		}
+		emit_instruction(jit, pc, opcode, op);
+		num_instructions++;
+		//A taken branch can cost two more
+		max_cycles += op->cycles + op->page_penalty + (op->mode == RELATIVE)*2;
+		pc += mode_lengths[op->mode];
+		end = pc - 1;
+		if(ends_block(opcode) || !can_translate(jit, pc)){
+			break;
+		}
+	}
+
+	if(!num_instructions){
+		jit->code_used = (unsigned char *) code - jit->code;
+		make_code_writable(jit, 0);
+		return 0;
+	}
+	emit_epilogue(jit);
+	make_code_writable(jit, 0);
+
+	block = jit->blocks + jit->num_blocks;
+	jit->num_blocks++;
+	block->start = start;
+	block->first_page = start>>8;
+	block->last_page = end>>8;
+	block->live = 1;
+	for(page = block->first_page; page <= block->last_page; page++){
+		if(is_ram_page(jit->bus, page)){
+			protect_code_page(jit->bus, page, jit->watcher, 1);
+		}
+	}
+	jit->entries[start] = code;
+	jit->entry_cycles[start] = max_cycles;
+
+	return 1;
+}
+
+JIT *jit_create(CPU_6502 *cpu, BUS *bus){
+	JIT *jit;
+
+	jit = malloc(sizeof(JIT));
+	if(!jit){
+		return NULL;
+	}
+	jit->watcher = add_code_watcher(bus, code_written, jit);
+	if(jit->watcher < 0){
+		free(jit);
+		return NULL;
+	}
+	jit->code = mmap(NULL, JIT_CODE_SIZE, PROT_READ | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if(jit->code == MAP_FAILED){
+		remove_code_watcher(bus, jit->watcher);
+		free(jit);
+		return NULL;
+	}
+	jit->cpu = cpu;
+	jit->bus = bus;
+	memset(jit->entries, 0, sizeof(jit->entries));
+	memset(jit->heat, 0, sizeof(jit->heat));
+	memset(jit->invalidations, 0, sizeof(jit->invalidations));
+	jit->num_blocks = 0;
+	jit->code_used = 0;
+	jit->exit = 0;
+
+	return jit;
+}
+
+void jit_free(JIT *jit){
+	jit_flush(jit);
+	remove_code_watcher(jit->bus, jit->watcher);
+	munmap(jit->code, JIT_CODE_SIZE);
+	free(jit);
+}
+
+void jit_flush(JIT *jit){
+	unsigned int i;
+
+	for(i = 0; i < jit->num_blocks; i++){
+		jit->entries[jit->blocks[i].start] = NULL;
+	}
+	for(i = 0; i < 256; i++){
+		if(jit->bus->code_pages[i]&(1<<jit->watcher)){
+			protect_code_page(jit->bus, i, jit->watcher, 0);
+		}
+	}
+	jit->num_blocks = 0;
+	//A block that is running stays intact until it returns, since nothing is emitted until then
+	jit->code_used = 0;
+	jit->exit = 1;
+}
+
+unsigned long long int jit_run(JIT *jit, unsigned long long int cycle_budget){
+	CPU_6502 *cpu = jit->cpu;
+	unsigned char *event = &jit->bus->event;
+	unsigned long long int start_cycles;
+	unsigned long long int end_cycles;
+	JIT_BLOCK_CODE code;
+
+	start_cycles = cpu->cycles;
+	end_cycles = start_cycles + cycle_budget;
+	*event = 0;
+	do{
+		code = jit->entries[cpu->PC_reg];
+		//Close to the end of the slice, step instead so as not to run past it
+		if(code && cpu->cycles + jit->entry_cycles[cpu->PC_reg] < end_cycles){
+			jit->exit = 0;
+			code(cpu, event, &jit->exit);
+		} else if(code){
+			execute_6502(cpu);
+		} else if(jit->heat[cpu->PC_reg] < JIT_HOT_COUNT){
+			jit->heat[cpu->PC_reg]++;
+			execute_6502(cpu);
+		} else if(!translate_block(jit, cpu->PC_reg)){
+			//Try again once it gets hot again, in case it can be translated by then
+			jit->heat[cpu->PC_reg] = 0;
+			execute_6502(cpu);
+		}
+	} while(cpu->cycles < end_cycles && !*event);
+
+	return cpu->cycles - start_cycles;
+}
+
+#else
+
+JIT *jit_create(CPU_6502 *cpu, BUS *bus){
+	return NULL;
+}
+
+void jit_free(JIT *jit){
+}
+
+unsigned long long int jit_run(JIT *jit, unsigned long long int cycle_budget){
+	return run_6502(jit->cpu, cycle_budget);
+}
+
+void jit_flush(JIT *jit){
+}
+
+#endif
@@ -0,0 +1,90 @@
+/*
+ * Dynamic recompiler
+ *
+ * Translates hot 6502 basic blocks into x86-64 code. Each translated
+ * instruction calls the same operation the interpreter would, with the
+ * effective address worked out at translation time wherever it can't
+ * change, so the fetch, decode and dispatch of every opcode are paid once
+ * per translation instead of once per execution. PC and cycles are kept
+ * exact after every instruction, so devices see the same timing as under
+ * the interpreter.
+ *
+ * Only code in RAM and ROM pages is translated. A block stops at any
+ * branch, jump, call or return, and where its code would run into a
+ * device page. It also returns early after any instruction that touched
+ * memory if a device raised an event.
+ *
+ * Pages of RAM holding translated code are marked on the bus so that a
+ * write to one drops every block that touches it. A page whose code keeps
+ * being rewritten is left to the interpreter.
+ *
+ * Translated code lives in a buffer that is never writable and executable
+ * at once: it is made writable while a block is emitted and executable
+ * again before anything runs.
+ */
+
+#ifndef JIT_H
+#define JIT_H
+
+#include <stdint.h>
+#include "cpu.h"
+#include "bus.h"
+
+//Times a block has to be reached before it is translated
+#define JIT_HOT_COUNT 16
+//Most instructions translated into one block
+#define JIT_MAX_BLOCK_INSTRUCTIONS 32
+#define JIT_MAX_BLOCKS 16384
+#define JIT_CODE_SIZE (4*1024*1024)
+//Times a page's code may be rewritten before it is no longer translated
+#define JIT_MAX_INVALIDATIONS 8
+
+typedef struct JIT JIT;
+
+typedef void (*JIT_BLOCK_CODE)(CPU_6502 *cpu, unsigned char *event, unsigned char *exit);
+
+typedef struct JIT_BLOCK JIT_BLOCK;
+
+struct JIT_BLOCK{
+	uint16_t start;
+	//Pages the block's 6502 code spans
+	uint8_t first_page;
+	uint8_t last_page;
+	unsigned char live;
+};
+
+struct JIT{
+	CPU_6502 *cpu;
+	BUS *bus;
+	//Which of the bus's code watchers this is
+	int watcher;
+
+	//Translated code for each address a block starts at, or NULL
+	JIT_BLOCK_CODE entries[0x10000];
+	//Most cycles each block can take, so a slice ends on the same instruction as under the interpreter
+	uint16_t entry_cycles[0x10000];
+	uint8_t heat[0x10000];
+
+	JIT_BLOCK blocks[JIT_MAX_BLOCKS];
+	unsigned int num_blocks;
+	unsigned int invalidations[256];
+
+	unsigned char *code;
+	unsigned int code_used;
+
+	//Set when the code being run may no longer match memory
+	unsigned char exit;
+};
+
+//Returns NULL if the host can't run translated code
+JIT *jit_create(CPU_6502 *cpu, BUS *bus);
+
+void jit_free(JIT *jit);
+
+//Run translated blocks, and the interpreter everywhere else, like run_6502
+unsigned long long int jit_run(JIT *jit, unsigned long long int cycle_budget);
+
+//Drop every block, for when memory changed without going through the bus
+void jit_flush(JIT *jit);
+
+#endif
@@ -0,0 +1,186 @@
+/*
+ * Apple 1 keyboard
+ */
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include "keyboard.h"
+#include "pace.h"
+#include "terminal.h"
+
+void keyboard_init(KEYBOARD *keyboard){
+	atomic_init(&keyboard->queue_start, 0);
+	atomic_init(&keyboard->queue_end, 0);
+	keyboard->data = 0;
+	keyboard->ready = 0;
+	keyboard->last_poll_time = 0;
+	keyboard->control_pending = 0;
+	keyboard->input_ended = 0;
+	keyboard->idle_pc = 0;
+	keyboard->idle_cycles = 0;
+	keyboard->idle_period = 0;
+	keyboard->idle_polls = 0;
+	keyboard->idle = 0;
+}
+
+static int keyboard_full(KEYBOARD *keyboard){
+	return atomic_load_explicit(&keyboard->queue_end, memory_order_relaxed) - atomic_load_explicit(&keyboard->queue_start, memory_order_acquire) == KEYBOARD_QUEUE_SIZE;
+}
+
+int keyboard_push(KEYBOARD *keyboard, uint8_t key){
+	unsigned int end;
+
+	if(keyboard_full(keyboard)){
+		return 0;
+	}
+	end = atomic_load_explicit(&keyboard->queue_end, memory_order_relaxed);
+	keyboard->queue[end&(KEYBOARD_QUEUE_SIZE - 1)] = key;
+	atomic_store_explicit(&keyboard->queue_end, end + 1, memory_order_release);
+
+	return 1;
+}
+
+//Move the next queued key into the keyboard register
+static void keyboard_latch(KEYBOARD *keyboard){
+	unsigned int start;
+
+	start = atomic_load_explicit(&keyboard->queue_start, memory_order_relaxed);
+	if(start == atomic_load_explicit(&keyboard->queue_end, memory_order_acquire)){
+		return;
+	}
+	keyboard->data = keyboard->queue[start&(KEYBOARD_QUEUE_SIZE - 1)];
+	keyboard->ready = 1;
+	atomic_store_explicit(&keyboard->queue_start, start + 1, memory_order_release);
+}
+
+int keyboard_pending(KEYBOARD *keyboard){
+	return keyboard->ready || atomic_load_explicit(&keyboard->queue_start, memory_order_relaxed) != atomic_load_explicit(&keyboard->queue_end, memory_order_acquire);
+}
+
+//Translate a key from the terminal into the Apple 1's key code, or return 0 to ignore it
+static uint8_t translate_key(KEYBOARD *keyboard, int key_hit){
+	if(keyboard->control_pending){//Emulate the control character
+		keyboard->control_pending = 0;
+		if(key_hit == 'd' || key_hit == 'D'){//Ctrl-D
+			return 0x84;
+		} else if(key_hit == 'g' || key_hit == 'G'){//Ctrl-G (bell character)
+			return 0x87;
+		} else if(key_hit == '`'){//Escape
+			return 0x9B;
+		}
+		return 0;
+	}
+
+	if(key_hit == 0x08 || key_hit == 0x7F){//Emulate the backspace character
+		return 0xDF;
+	} else if(key_hit == '~'){
+		keyboard->control_pending = 1;
+		return 0;
+	}
+
+	//Convert lower case characters to upper case
+	if(key_hit >= 'a' && key_hit <= 'z'){
+		key_hit += 'A' - 'a';
+	}
+
+	//Replace \n with \r
+	if(key_hit == '\n'){
+		key_hit = '\r';
+	}
+
+	return key_hit|0x80;
+}
+
+int keyboard_type(KEYBOARD *keyboard, int key_hit){
+	uint8_t key;
+
+	if(keyboard_full(keyboard)){
+		return 0;
+	}
+	key = translate_key(keyboard, key_hit);
+	if(key){
+		keyboard_push(keyboard, key);
+	}
+
+	return 1;
+}
+
+int keyboard_poll(KEYBOARD *keyboard){
+	long long int current_time;
+	int key_hit;
+
+	current_time = pace_now();
+	if(current_time - keyboard->last_poll_time < KEYBOARD_POLL_INTERVAL){
+		return KEYBOARD_IDLE;
+	}
+	keyboard->last_poll_time = current_time;
+
+	//Keys are left with the terminal while the queue is full, so none are lost
+	key_hit = NO_KEY;
+	while(!keyboard_full(keyboard) && (key_hit = terminal->get_key()) >= 0){
+		if(key_hit == '|'){
+			return KEYBOARD_DEBUG;
+		}
+		keyboard_type(keyboard, key_hit);
+	}
+	if(key_hit == END_OF_INPUT){
+		keyboard->input_ended = 1;
+	}
+
+	return KEYBOARD_IDLE;
+}
+
+uint8_t keyboard_read_data(KEYBOARD *keyboard){
+	keyboard->ready = 0;
+	return keyboard->data;
+}
+
+uint8_t keyboard_read_status(KEYBOARD *keyboard, uint16_t pc, unsigned long long int cycles){
+	if(!keyboard->ready){
+		keyboard_latch(keyboard);
+	}
+
+	if(keyboard->ready){
+		keyboard->idle_polls = 0;
+	} else if(pc == keyboard->idle_pc && cycles - keyboard->idle_cycles <= KEYBOARD_IDLE_WINDOW){
+		keyboard->idle_period = cycles - keyboard->idle_cycles;
+		keyboard->idle_polls++;
+		if(keyboard->idle_polls >= KEYBOARD_IDLE_POLLS){
+			keyboard->idle = 1;
+		}
+	} else {
+		keyboard->idle_polls = 0;
+	}
+	keyboard->idle_pc = pc;
+	keyboard->idle_cycles = cycles;
+
+	return keyboard->ready<<7;
+}
+
+void keyboard_wake(KEYBOARD *keyboard){
+	keyboard->idle = 0;
+	keyboard->idle_polls = 0;
+}
+
+unsigned long long int keyboard_wait_idle(KEYBOARD *keyboard, unsigned long long int clock_rate){
+	long long int start_time;
+	unsigned long long int idle_cycles;
+
+	start_time = pace_now();
+	terminal->wait_input(KEYBOARD_IDLE_WAIT);
+
+	//Let the next poll pick up whatever woke us
+	keyboard->last_poll_time = 0;
+	keyboard_wake(keyboard);
+
+	if(!clock_rate || !keyboard->idle_period){
+		return 0;
+	}
+	//Whole trips around the polling loop that fit in the time spent waiting
+	idle_cycles = (unsigned long long int) (pace_now() - start_time)*clock_rate/1000000000ULL;
+	idle_cycles -= idle_cycles%keyboard->idle_period;
+	//The loop's position in time moves on with the skipped cycles
+	keyboard->idle_cycles += idle_cycles;
+
+	return idle_cycles;
+}
@@ -0,0 +1,88 @@
+/*
+ * Apple 1 keyboard
+ *
+ * The host terminal is polled at a fixed wall-clock rate, independent of
+ * what the CPU is doing. Keys wait in a queue and are latched into the
+ * keyboard register once the program has read the previous key, so
+ * typing ahead or pasting doesn't lose characters.
+ *
+ * The queue is a single-producer single-consumer ring, so it stays
+ * correct if keys are ever pushed from another thread.
+ */
+
+#ifndef KEYBOARD_H
+#define KEYBOARD_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+//Must be a power of two
+#define KEYBOARD_QUEUE_SIZE 4096
+
+//How often the host terminal is polled for keys, in nanoseconds
+#define KEYBOARD_POLL_INTERVAL 10000000LL
+
+//A program polling 0xD011 from the same place at most this many cycles apart is waiting for a key
+#define KEYBOARD_IDLE_WINDOW 32
+//Number of empty polls in a row before the program is considered idle
+#define KEYBOARD_IDLE_POLLS 16
+//Longest the host blocks on the terminal at once while idle, in milliseconds
+#define KEYBOARD_IDLE_WAIT 100
+
+//Results of keyboard_poll
+#define KEYBOARD_IDLE 0
+//The user typed the key that opens the debug prompt
+#define KEYBOARD_DEBUG 1
+
+typedef struct KEYBOARD KEYBOARD;
+
+struct KEYBOARD{
+	uint8_t queue[KEYBOARD_QUEUE_SIZE];
+	atomic_uint queue_start;
+	atomic_uint queue_end;
+	//The key in the keyboard register and whether it is waiting to be read
+	uint8_t data;
+	uint8_t ready;
+	long long int last_poll_time;
+	//Set after a ~ until the key it modifies arrives
+	unsigned char control_pending;
+	//The terminal has no more input to give
+	unsigned char input_ended;
+	//Detection of a program spinning on 0xD011 with no key coming
+	uint16_t idle_pc;
+	unsigned long long int idle_cycles;
+	unsigned long long int idle_period;
+	unsigned int idle_polls;
+	unsigned char idle;
+};
+
+void keyboard_init(KEYBOARD *keyboard);
+
+//Queue an Apple 1 key code. Returns 0 if the queue is full.
+int keyboard_push(KEYBOARD *keyboard, uint8_t key);
+
+//Queue a key typed on the host, translated the same way as keys from the terminal
+//Returns 0 if the queue is full
+int keyboard_type(KEYBOARD *keyboard, int key_hit);
+
+//Whether a key is latched or queued
+int keyboard_pending(KEYBOARD *keyboard);
+
+//Poll the terminal if the poll interval has passed
+int keyboard_poll(KEYBOARD *keyboard);
+
+//Reading 0xD010 takes the key out of the register
+uint8_t keyboard_read_data(KEYBOARD *keyboard);
+
+//Bit 7 of 0xD011 is set while a key is waiting
+//pc and cycles locate the read for idle detection
+uint8_t keyboard_read_status(KEYBOARD *keyboard, uint16_t pc, unsigned long long int cycles);
+
+//Start looking for idling afresh
+void keyboard_wake(KEYBOARD *keyboard);
+
+//Block on the terminal while the program is idle
+//Returns the number of cycles the program would have spun for at clock_rate
+unsigned long long int keyboard_wait_idle(KEYBOARD *keyboard, unsigned long long int clock_rate);
+
+#endif
@@ -0,0 +1,385 @@
+/*
+ * Apple 1 machine
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "machine.h"
+#include "snapshot.h"
+#include "terminal.h"
+
+//Woz's ACI on page 0xC0
+//Any access while recording toggles the tape output, and the input level selects between even and odd bytes
+static uint8_t read_aci(void *context, uint16_t index){
+	MACHINE *machine = context;
+
+	machine_update_tape(machine);
+	if(machine->tape_writing){
+		if(machine->tape_active){
+			machine->tape_index++;
+		}
+	} else if(index >= 0xC081){
+		if(machine->current_tape_value){
+			return machine->memory[index];
+		} else {
+			return machine->memory[index&0xFFFE];
+		}
+	}
+
+	return machine->memory[index];
+}
+
+static void write_aci(void *context, uint16_t index, uint8_t value){
+}
+
+//The keyboard and display PIA on page 0xD0
+static uint8_t read_pia(void *context, uint16_t index){
+	MACHINE *machine = context;
+	uint8_t value;
+
+	if(index == 0xD010){
+		return keyboard_read_data(&machine->keyboard);
+	} else if(index == 0xD011){
+		value = (machine->memory[0xD011]&0x7F)|keyboard_read_status(&machine->keyboard, machine->cpu.PC_reg, machine->cpu.cycles);
+		//Stop the slice so the host can sleep until a key comes
+		if(machine->keyboard.idle){
+			machine->bus.event = 1;
+		}
+		return value;
+	} else if((index&0xFF0F) == 0xD002){
+		return display_status(&machine->display, machine->cpu.cycles);
+	}
+
+	return machine->memory[index];
+}
+
+static void write_pia(void *context, uint16_t index, uint8_t value){
+	MACHINE *machine = context;
+
+	if((index&0xFF0F) == 0xD002){
+		display_write(&machine->display, value, machine->cpu.cycles);
+	}
+	machine->memory[index] = value;
+}
+
+//Translated code no longer matches memory that changed behind the bus's back
+static void forget_code(MACHINE *machine){
+	flush_decode_cache(&machine->cpu);
+	if(machine->jit){
+		jit_flush(machine->jit);
+	}
+	if(machine->aot){
+		aot_check(machine->aot);
+	}
+}
+
+//The host file bridge
+static uint8_t read_bridge(void *context, uint16_t index){
+	MACHINE *machine = context;
+
+	return bridge_read(&machine->bridge, index&0xFF);
+}
+
+static void write_bridge(void *context, uint16_t index, uint8_t value){
+	MACHINE *machine = context;
+
+	bridge_write(&machine->bridge, index&0xFF, value);
+}
+
+//Print every memory access while single stepping
+static void trace_mem(void *context, uint16_t index, uint8_t value, unsigned char is_write){
+	if(is_write){
+		term_printf("WRITE: %02x --> %04x\n", value, index);
+	} else {
+		term_printf("READ: %04x %02x\n", index, value);
+	}
+}
+
+void machine_init(MACHINE *machine, unsigned char slow_display){
+	memset(machine->memory, 0, sizeof(machine->memory));
+	memset(&machine->cpu, 0, sizeof(machine->cpu));
+	machine->cpu.bus = &machine->bus;
+	set_status_6502(&machine->cpu, 0);
+	bus_init(&machine->bus);
+	map_ram(&machine->bus, 0x00, 256, machine->memory);
+
+	display_init(&machine->display, slow_display);
+	keyboard_init(&machine->keyboard);
+	bridge_init(&machine->bridge, &machine->bus, machine->memory);
+
+	tape_init(&machine->tape);
+	machine->tape_index = 0;
+	machine->tape_next_edge = 0;
+	machine->last_cycles = 0;
+	machine->tape_active = 0;
+	machine->tape_writing = 0;
+	machine->tape_reading = 0;
+	machine->current_tape_value = 0;
+
+	machine->debug_step = 0;
+	machine->basic_loaded = 0;
+	machine->jit = NULL;
+	machine->aot = NULL;
+	//Without the cache every instruction is decoded each time it runs, which is slower but still correct
+	enable_decode_cache(&machine->cpu);
+}
+
+void machine_free(MACHINE *machine){
+	if(machine->jit){
+		jit_free(machine->jit);
+		machine->jit = NULL;
+	}
+	if(machine->aot){
+		aot_free(machine->aot);
+		machine->aot = NULL;
+	}
+	disable_decode_cache(&machine->cpu);
+	free(machine->tape.widths);
+	machine->tape.widths = NULL;
+}
+
+int machine_enable_jit(MACHINE *machine){
+	if(!machine->jit){
+		machine->jit = jit_create(&machine->cpu, &machine->bus);
+	}
+
+	return machine->jit != NULL;
+}
+
+int machine_load_rom(MACHINE *machine, const char *file_name, uint16_t address, unsigned int size){
+	FILE *fp;
+	int success;
+
+	fp = fopen(file_name, "rb");
+	if(!fp){
+		return 0;
+	}
+	success = fread(machine->memory + address, 1, size, fp) == size;
+	fclose(fp);
+	forget_code(machine);
+
+	return success;
+}
+
+void machine_map(MACHINE *machine, unsigned char enable_bridge){
+	if(machine->basic_loaded){
+		map_rom(&machine->bus, 0xE0, 0x10, machine->memory + 0xE000);
+	}
+
+	//The ACI's ROM shows up on both of its pages
+	memcpy(machine->memory + 0xC100, machine->memory + 0xC000, 0x100);
+	map_device(&machine->bus, 0xC0, read_aci, write_aci, machine);
+	map_rom(&machine->bus, 0xC1, 1, machine->memory + 0xC100);
+	map_device(&machine->bus, 0xD0, read_pia, write_pia, machine);
+	if(enable_bridge){
+		map_device(&machine->bus, BRIDGE_PAGE, read_bridge, write_bridge, machine);
+	}
+
+	map_rom(&machine->bus, 0xFF, 1, machine->memory + 0xFF00);
+	//Only once the ROMs are mapped can their translations be matched up
+	if(!machine->aot){
+		machine->aot = aot_create(&machine->cpu, &machine->bus);
+	}
+	forget_code(machine);
+}
+
+void machine_reset(MACHINE *machine){
+	reset_6502(&machine->cpu);
+	machine->cpu.cycles = 0;
+	machine->last_cycles = 0;
+}
+
+unsigned long long int machine_run(MACHINE *machine, unsigned long long int cycle_budget){
+	unsigned long long int cycles;
+
+	//Single stepping needs every instruction to come back to the host
+	if(machine->jit && !machine->debug_step){
+		cycles = jit_run(machine->jit, cycle_budget);
+	} else if(machine->aot && machine->aot->num_entries && !machine->debug_step){
+		cycles = aot_run(machine->aot, cycle_budget);
+	} else {
+		cycles = run_6502(&machine->cpu, cycle_budget);
+	}
+	machine_update_tape(machine);
+
+	return cycles;
+}
+
+void machine_set_debug(MACHINE *machine, unsigned char debug_step){
+	machine->debug_step = debug_step;
+	set_bus_trace(&machine->bus, debug_step ? trace_mem : NULL, machine);
+}
+
+void machine_update_tape(MACHINE *machine){
+	TAPE *tape = &machine->tape;
+	uint32_t *width;
+
+	if(machine->tape_active && machine->tape_reading){
+		//The level holds once the recording runs out
+		while(machine->tape_index < tape->length && machine->tape_next_edge < machine->cpu.cycles){
+			machine->current_tape_value = !machine->current_tape_value;
+			machine->tape_index++;
+			if(machine->tape_index < tape->length){
+				machine->tape_next_edge += tape->widths[machine->tape_index];
+			}
+		}
+	} else if(machine->tape_active && machine->tape_writing){
+		width = tape_slot(tape, machine->tape_index);
+		if(width){
+			*width += machine->cpu.cycles - machine->last_cycles;
+		}
+	}
+	machine->last_cycles = machine->cpu.cycles;
+}
+
+void machine_start_tape(MACHINE *machine, unsigned char writing){
+	TAPE *tape = &machine->tape;
+
+	machine->tape_active = 1;
+	if(writing){
+		machine->tape_writing = 1;
+		tape_clear(tape);
+	} else {
+		machine->tape_reading = 1;
+		machine->current_tape_value = 0;
+		machine->tape_next_edge = machine->cpu.cycles + (tape->length ? tape->widths[0] : 0);
+	}
+	machine->tape_index = 0;
+	machine->last_cycles = machine->cpu.cycles;
+}
+
+void machine_stop_tape(MACHINE *machine){
+	machine_update_tape(machine);
+	machine->tape_active = 0;
+	machine->tape_writing = 0;
+	machine->tape_reading = 0;
+}
+
+int machine_is_ram(MACHINE *machine, uint16_t start, uint16_t end){
+	unsigned int page;
+
+	for(page = start>>8; page <= (unsigned int) (end>>8); page++){
+		if(!is_ram_page(&machine->bus, page)){
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+uint32_t machine_fast_load(MACHINE *machine, uint16_t start, uint16_t end, uint16_t *checksum){
+	TAPE *tape = &machine->tape;
+	unsigned char playing;
+	uint32_t index;
+	uint32_t count;
+	uint32_t i;
+	uint8_t *buffer;
+
+	*checksum = 0;
+	if(!machine_is_ram(machine, start, end)){
+		return 0;
+	}
+
+	//Carry on from wherever the tape is playing
+	index = 0;
+	playing = machine->tape_active && machine->tape_reading;
+	if(playing){
+		machine_update_tape(machine);
+		index = machine->tape_index;
+	}
+	//Decoded bytes go through the bus so translations of the code they replace are dropped
+	buffer = malloc(end - start + 1);
+	if(!buffer){
+		return 0;
+	}
+	count = tape_decode(tape, &index, buffer, end - start + 1, CLOCK_RATE);
+
+	*checksum = 0;
+	for(i = 0; i < count; i++){
+		bus_write(&machine->bus, start + i, buffer[i]);
+		*checksum += buffer[i];
+	}
+	free(buffer);
+
+	if(playing && count){
+		//Each edge toggles the level from the 0 it starts at, so skipping edges keeps it in step
+		machine->tape_index = index;
+		machine->current_tape_value = index&1;
+		if(index < tape->length){
+			machine->tape_next_edge = machine->cpu.cycles + tape->widths[index];
+		}
+	}
+
+	return count;
+}
+
+uint32_t machine_rom_checksum(MACHINE *machine){
+	uint32_t checksum = 2166136261UL;
+	unsigned int i;
+
+	for(i = 0; i < 0x10000; i++){
+		if((i >= 0xC000 && i < 0xC100) || (i >= 0xE000 && i < 0xF000) || i >= 0xFF00){
+			checksum = (checksum^machine->memory[i])*16777619UL;
+		}
+	}
+
+	return checksum;
+}
+
+int machine_save_snapshot(MACHINE *machine, const char *file_name){
+	SNAPSHOT snapshot;
+
+	machine_update_tape(machine);
+	snapshot.cpu = machine->cpu;
+	snapshot.memory = machine->memory;
+	snapshot.key_data = machine->keyboard.data;
+	snapshot.key_ready = machine->keyboard.ready;
+	snapshot.display_ready_cycles = machine->display.ready_cycles;
+	snapshot.tape = &machine->tape;
+	snapshot.tape_active = machine->tape_active;
+	snapshot.tape_writing = machine->tape_writing;
+	snapshot.tape_reading = machine->tape_reading;
+	snapshot.tape_value = machine->current_tape_value;
+	snapshot.tape_index = machine->tape_index;
+	snapshot.tape_next_edge = machine->tape_next_edge;
+	snapshot.tape_last_cycles = machine->last_cycles;
+	snapshot.basic_rom = machine->basic_loaded;
+
+	return snapshot_save(&snapshot, file_name);
+}
+
+int machine_load_snapshot(MACHINE *machine, const char *file_name){
+	SNAPSHOT snapshot;
+
+	//The registers are filled in over a copy so the CPU keeps its bus and decode cache
+	snapshot.cpu = machine->cpu;
+	snapshot.memory = machine->memory;
+	snapshot.tape = &machine->tape;
+	forget_code(machine);
+	if(!snapshot_load(&snapshot, file_name)){
+		return 0;
+	}
+
+	machine->cpu = snapshot.cpu;
+	machine->keyboard.data = snapshot.key_data;
+	machine->keyboard.ready = snapshot.key_ready;
+	machine->display.ready_cycles = snapshot.display_ready_cycles;
+	machine->tape_active = snapshot.tape_active;
+	machine->tape_writing = snapshot.tape_writing;
+	machine->tape_reading = snapshot.tape_reading;
+	machine->current_tape_value = snapshot.tape_value;
+	machine->tape_index = snapshot.tape_index;
+	machine->tape_next_edge = snapshot.tape_next_edge;
+	machine->last_cycles = snapshot.tape_last_cycles;
+	//BASIC that was in ROM when the snapshot was taken stays protected, whether or not the ROMs are mapped yet
+	if(snapshot.basic_rom && !machine->basic_loaded){
+		machine->basic_loaded = 1;
+		map_rom(&machine->bus, 0xE0, 0x10, machine->memory + 0xE000);
+	}
+	//Memory is only replaced once the whole snapshot has been read, so the code to check is the new image
+	forget_code(machine);
+
+	return 1;
+}
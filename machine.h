@@ -0,0 +1,107 @@
+/*
+ * Apple 1 machine
+ *
+ * Everything one emulated Apple 1 owns: the CPU, its bus and memory, the
+ * devices and the cassette deck. Nothing here is global, so any number
+ * of machines can run in one process, each on its own thread if need be.
+ */
+
+#ifndef MACHINE_H
+#define MACHINE_H
+
+#include <stdint.h>
+#include "cpu.h"
+#include "bus.h"
+#include "display.h"
+#include "keyboard.h"
+#include "tape.h"
+#include "bridge.h"
+#include "jit.h"
+#include "aot.h"
+
+//The 6502 on the Apple 1 was clocked at 1 MHz
+#define CLOCK_RATE 1000000
+
+typedef struct MACHINE MACHINE;
+
+struct MACHINE{
+	CPU_6502 cpu;
+	BUS bus;
+	uint8_t memory[0x10000];
+	DISPLAY display;
+	KEYBOARD keyboard;
+	BRIDGE bridge;
+
+	//Cassette deck
+	TAPE tape;
+	uint32_t tape_index;
+	//Cycle count at which the level read from the tape next changes
+	unsigned long long int tape_next_edge;
+	//Cycle count the tape has been brought up to
+	unsigned long long int last_cycles;
+	unsigned char tape_active;
+	unsigned char tape_writing;
+	unsigned char tape_reading;
+	unsigned char current_tape_value;
+
+	//Single stepping with every memory access printed
+	unsigned char debug_step;
+	//Whether BASIC was loaded from a ROM file
+	unsigned char basic_loaded;
+
+	//Translates hot code when enabled, or NULL to only interpret
+	JIT *jit;
+	//ROM code translated ahead of time, or NULL if none was built in
+	AOT *aot;
+};
+
+//Set up a machine with RAM everywhere and nothing loaded
+void machine_init(MACHINE *machine, unsigned char slow_display);
+
+//Release what the machine allocated
+void machine_free(MACHINE *machine);
+
+//Run hot code through the dynamic recompiler
+//Returns 0 if the host can't run translated code
+int machine_enable_jit(MACHINE *machine);
+
+//Read size bytes of ROM from a file into memory at address
+//Returns 0 if the file couldn't be read
+int machine_load_rom(MACHINE *machine, const char *file_name, uint16_t address, unsigned int size);
+
+//Map the ROMs and devices once the ROMs are loaded
+void machine_map(MACHINE *machine, unsigned char enable_bridge);
+
+//Reset the CPU and start counting cycles from zero
+void machine_reset(MACHINE *machine);
+
+//Run a slice of up to cycle_budget cycles and bring the tape up to date
+unsigned long long int machine_run(MACHINE *machine, unsigned long long int cycle_budget);
+
+//Turn single stepping with traced memory accesses on or off
+void machine_set_debug(MACHINE *machine, unsigned char debug_step);
+
+//Bring the tape up to date with the cycle count of the CPU
+void machine_update_tape(MACHINE *machine);
+
+//Start recording onto a blank tape or playing back the loaded one
+void machine_start_tape(MACHINE *machine, unsigned char writing);
+
+void machine_stop_tape(MACHINE *machine);
+
+//Whether every page from start to end is RAM
+int machine_is_ram(MACHINE *machine, uint16_t start, uint16_t end);
+
+//Decode the next block on the tape into memory from start, at most up to end
+//Returns the number of bytes loaded and their sum in checksum, or 0 if the range isn't all RAM
+uint32_t machine_fast_load(MACHINE *machine, uint16_t start, uint16_t end, uint16_t *checksum);
+
+//Identifies the ROMs loaded
+uint32_t machine_rom_checksum(MACHINE *machine);
+
+//Both return 0 if the file couldn't be written or read
+int machine_save_snapshot(MACHINE *machine, const char *file_name);
+
+int machine_load_snapshot(MACHINE *machine, const char *file_name);
+
+#endif
@@ -0,0 +1,78 @@
+/*
+ * 6502 operations
+ *
+ * The operations the CPU core carries out for each opcode, for code that
+ * calls them directly instead of going through the decode table.
+ * Each is handed the effective address of its operand, with PC already
+ * pointing to the next instruction.
+ */
+
+#ifndef OPERATIONS_H
+#define OPERATIONS_H
+
+#include <stdint.h>
+#include "cpu.h"
+
+void adc(CPU_6502 *cpu, uint16_t address);
+void and(CPU_6502 *cpu, uint16_t address);
+void asl_a(CPU_6502 *cpu, uint16_t address);
+void asl(CPU_6502 *cpu, uint16_t address);
+void bcc(CPU_6502 *cpu, uint16_t address);
+void bcs(CPU_6502 *cpu, uint16_t address);
+void beq(CPU_6502 *cpu, uint16_t address);
+void bit(CPU_6502 *cpu, uint16_t address);
+void bmi(CPU_6502 *cpu, uint16_t address);
+void bne(CPU_6502 *cpu, uint16_t address);
+void bpl(CPU_6502 *cpu, uint16_t address);
+void brk(CPU_6502 *cpu, uint16_t address);
+void bvc(CPU_6502 *cpu, uint16_t address);
+void bvs(CPU_6502 *cpu, uint16_t address);
+void clc(CPU_6502 *cpu, uint16_t address);
+void cld(CPU_6502 *cpu, uint16_t address);
+void cli(CPU_6502 *cpu, uint16_t address);
+void clv(CPU_6502 *cpu, uint16_t address);
+void cmp(CPU_6502 *cpu, uint16_t address);
+void cpx(CPU_6502 *cpu, uint16_t address);
+void cpy(CPU_6502 *cpu, uint16_t address);
+void dec(CPU_6502 *cpu, uint16_t address);
+void dex(CPU_6502 *cpu, uint16_t address);
+void dey(CPU_6502 *cpu, uint16_t address);
+void eor(CPU_6502 *cpu, uint16_t address);
+void inc(CPU_6502 *cpu, uint16_t address);
+void inx(CPU_6502 *cpu, uint16_t address);
+void iny(CPU_6502 *cpu, uint16_t address);
+void jmp(CPU_6502 *cpu, uint16_t address);
+void jsr(CPU_6502 *cpu, uint16_t address);
+void lda(CPU_6502 *cpu, uint16_t address);
+void ldx(CPU_6502 *cpu, uint16_t address);
+void ldy(CPU_6502 *cpu, uint16_t address);
+void lsr_a(CPU_6502 *cpu, uint16_t address);
+void lsr(CPU_6502 *cpu, uint16_t address);
+void nop(CPU_6502 *cpu, uint16_t address);
+void ora(CPU_6502 *cpu, uint16_t address);
+void pha(CPU_6502 *cpu, uint16_t address);
+void php(CPU_6502 *cpu, uint16_t address);
+void pla(CPU_6502 *cpu, uint16_t address);
+void plp(CPU_6502 *cpu, uint16_t address);
+void rol_a(CPU_6502 *cpu, uint16_t address);
+void rol(CPU_6502 *cpu, uint16_t address);
+void ror_a(CPU_6502 *cpu, uint16_t address);
+void ror(CPU_6502 *cpu, uint16_t address);
+void rti(CPU_6502 *cpu, uint16_t address);
+void rts(CPU_6502 *cpu, uint16_t address);
+void sbc(CPU_6502 *cpu, uint16_t address);
+void sec(CPU_6502 *cpu, uint16_t address);
+void sed(CPU_6502 *cpu, uint16_t address);
+void sei(CPU_6502 *cpu, uint16_t address);
+void sta(CPU_6502 *cpu, uint16_t address);
+void stx(CPU_6502 *cpu, uint16_t address);
+void sty(CPU_6502 *cpu, uint16_t address);
+void tax(CPU_6502 *cpu, uint16_t address);
+void tay(CPU_6502 *cpu, uint16_t address);
+void tsx(CPU_6502 *cpu, uint16_t address);
+void txa(CPU_6502 *cpu, uint16_t address);
+void txs(CPU_6502 *cpu, uint16_t address);
+void tya(CPU_6502 *cpu, uint16_t address);
+void unknown(CPU_6502 *cpu, uint16_t address);
+
+#endif
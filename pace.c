@@ -0,0 +1,78 @@
+/*
+ * Real-time pacing
+ */
+
+#include <time.h>
+#include "pace.h"
+
+#ifdef _WIN32
+
+#include <windows.h>
+
+#endif
+
+long long int pace_now(){
+	struct timespec current_time;
+
+	clock_gettime(CLOCK_MONOTONIC, &current_time);
+	return (long long int) current_time.tv_sec*1000000000LL + current_time.tv_nsec;
+}
+
+static void pace_sleep(long long int nsec){
+#ifdef _WIN32
+	Sleep(nsec/1000000);
+#else
+	struct timespec sleep_time;
+
+	sleep_time.tv_sec = nsec/1000000000LL;
+	sleep_time.tv_nsec = nsec%1000000000LL;
+	nanosleep(&sleep_time, NULL);
+#endif
+}
+
+void pace_start(PACER *pacer, unsigned long long int clock_rate, unsigned long long int cycles){
+	pacer->clock_rate = clock_rate;
+	pacer->start_time = pace_now();
+	pacer->start_cycles = cycles;
+	pacer->rate_time = pacer->start_time;
+	pacer->rate_cycles = cycles;
+	pacer->effective_rate = 0;
+}
+
+int pace(PACER *pacer, unsigned long long int cycles){
+	long long int current_time;
+	long long int target_time;
+	int measured;
+
+	current_time = pace_now();
+
+	//Measure how fast the CPU actually ran
+	measured = 0;
+	if(current_time - pacer->rate_time >= PACE_RATE_PERIOD){
+		pacer->effective_rate = (double) (cycles - pacer->rate_cycles)*1000000000.0/(current_time - pacer->rate_time);
+		pacer->rate_time = current_time;
+		pacer->rate_cycles = cycles;
+		measured = 1;
+	}
+
+	if(!pacer->clock_rate){
+		return measured;
+	}
+
+	/* Work out when the emulated machine would have reached this cycle.
+	 * Measuring from a fixed starting point means oversleeping and
+	 * host overhead are made up for on later slices instead of
+	 * accumulating.
+	 */
+	target_time = pacer->start_time + (long long int) ((double) (cycles - pacer->start_cycles)*1000000000.0/pacer->clock_rate);
+
+	if(target_time > current_time){
+		pace_sleep(target_time - current_time);
+	} else if(current_time - target_time > PACE_MAX_LAG){
+		//The host stalled for too long to catch up on, so continue from here
+		pacer->start_time = current_time;
+		pacer->start_cycles = cycles;
+	}
+
+	return measured;
+}
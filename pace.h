@@ -0,0 +1,44 @@
+/*
+ * Real-time pacing
+ *
+ * Keeps the emulated clock in step with the host's monotonic clock. The
+ * host runs the CPU in slices and calls pace() after each one, which
+ * sleeps off whatever time the slice ran ahead of real time.
+ */
+
+#ifndef PACE_H
+#define PACE_H
+
+#include <time.h>
+
+//Running behind by more than this many nanoseconds means the host stalled, so pacing starts over
+#define PACE_MAX_LAG 250000000LL
+
+//How often the effective clock rate is measured, in nanoseconds
+#define PACE_RATE_PERIOD 1000000000LL
+
+typedef struct PACER PACER;
+
+struct PACER{
+	//Emulated cycles per second, or 0 to run unthrottled
+	unsigned long long int clock_rate;
+	//Wall time and cycle count that the schedule is measured from
+	long long int start_time;
+	unsigned long long int start_cycles;
+	//Measurement of the effective clock rate
+	long long int rate_time;
+	unsigned long long int rate_cycles;
+	double effective_rate;
+};
+
+//Start pacing from the given cycle count at the current time
+void pace_start(PACER *pacer, unsigned long long int clock_rate, unsigned long long int cycles);
+
+//Sleep until real time catches up with the emulated cycle count
+//Returns 1 when a new measurement of the effective clock rate is available
+int pace(PACER *pacer, unsigned long long int cycles);
+
+//Current host time in nanoseconds from CLOCK_MONOTONIC
+long long int pace_now();
+
+#endif
@@ -0,0 +1,83 @@
+/*
+ * Fork server
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "server.h"
+
+#ifdef _WIN32
+
+int serve(const char *socket_path){
+	fprintf(stderr, "Serving jobs isn't supported on Windows\n");
+	return 0;
+}
+
+#else
+
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+int serve(const char *socket_path){
+	struct sockaddr_un address;
+	int server_fd;
+	int connection_fd;
+	pid_t pid;
+
+	if(strlen(socket_path) >= sizeof(address.sun_path)){
+		fprintf(stderr, "Socket path \"%s\" is too long\n", socket_path);
+		return 0;
+	}
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	strcpy(address.sun_path, socket_path);
+
+	server_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if(server_fd < 0){
+		perror("socket");
+		return 0;
+	}
+	unlink(socket_path);
+	if(bind(server_fd, (struct sockaddr *) &address, sizeof(address)) || listen(server_fd, SERVER_BACKLOG)){
+		perror(socket_path);
+		close(server_fd);
+		return 0;
+	}
+
+	//Children are reaped automatically
+	signal(SIGCHLD, SIG_IGN);
+	fprintf(stderr, "Serving jobs on \"%s\"\n", socket_path);
+
+	while(1){
+		connection_fd = accept(server_fd, NULL, NULL);
+		if(connection_fd < 0){
+			if(errno == EINTR || errno == ECONNABORTED){
+				continue;
+			}
+			perror("accept");
+			close(server_fd);
+			return 0;
+		}
+
+		//Don't let the child inherit anything still waiting to be written
+		fflush(stdout);
+		fflush(stderr);
+		pid = fork();
+		if(!pid){
+			close(server_fd);
+			signal(SIGCHLD, SIG_DFL);
+			dup2(connection_fd, 0);
+			dup2(connection_fd, 1);
+			close(connection_fd);
+			return 1;
+		} else if(pid < 0){
+			perror("fork");
+		}
+		close(connection_fd);
+	}
+}
+
+#endif
@@ -0,0 +1,20 @@
+/*
+ * Fork server
+ *
+ * Boots the machine once, then serves jobs on a Unix socket. Each
+ * connection gets a child process holding a copy-on-write clone of the
+ * machine, with the connection as its stdin and stdout. A client sends
+ * the keys to type, closes its side for writing and reads the display
+ * output until the child exits.
+ */
+
+#ifndef SERVER_H
+#define SERVER_H
+
+//Connections waiting to be accepted
+#define SERVER_BACKLOG 64
+
+//Only returns in a child, with 1, or with 0 if the server couldn't run
+int serve(const char *socket_path);
+
+#endif
@@ -0,0 +1,211 @@
+/*
+ * Machine snapshots
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "snapshot.h"
+
+static const char snapshot_magic[8] = {'A', '1', 'S', 'N', 'A', 'P', 0, 0};
+
+//Offsets of the fields in the header
+#define MAGIC 0
+#define VERSION 8
+#define MEMORY_OFFSET 12
+#define TAPE_LENGTH 16
+#define A_REG 20
+#define X_REG 21
+#define Y_REG 22
+#define SP_REG 23
+#define P_REG 24
+#define HALTED 25
+#define PC_REG 26
+#define CYCLES 28
+#define KEY_DATA 36
+#define KEY_READY 37
+#define DISPLAY_READY_CYCLES 40
+#define TAPE_ACTIVE 48
+#define TAPE_WRITING 49
+#define TAPE_READING 50
+#define TAPE_VALUE 51
+#define TAPE_INDEX 52
+#define TAPE_NEXT_EDGE 56
+#define TAPE_LAST_CYCLES 64
+#define BASIC_ROM 72
+
+static void write_le(uint8_t *buffer, uint64_t value, int size){
+	int i;
+
+	for(i = 0; i < size; i++){
+		buffer[i] = value>>(8*i);
+	}
+}
+
+static uint64_t read_le(const uint8_t *buffer, int size){
+	uint64_t value = 0;
+	int i;
+
+	for(i = size - 1; i >= 0; i--){
+		value = value<<8 | buffer[i];
+	}
+
+	return value;
+}
+
+//Widths are four bytes each, little endian like the header
+static int write_widths(FILE *fp, const uint32_t *widths, uint32_t length){
+	uint8_t buffer[TAPE_CHUNK_SIZE];
+	uint32_t count;
+	uint32_t i;
+
+	while(length){
+		count = length < TAPE_CHUNK_SIZE/4 ? length : TAPE_CHUNK_SIZE/4;
+		for(i = 0; i < count; i++){
+			write_le(buffer + 4*i, widths[i], 4);
+		}
+		if(fwrite(buffer, 4, count, fp) != count){
+			return 0;
+		}
+		widths += count;
+		length -= count;
+	}
+
+	return 1;
+}
+
+static int read_widths(FILE *fp, uint32_t *widths, uint32_t length){
+	uint8_t buffer[TAPE_CHUNK_SIZE];
+	uint32_t count;
+	uint32_t i;
+
+	while(length){
+		count = length < TAPE_CHUNK_SIZE/4 ? length : TAPE_CHUNK_SIZE/4;
+		if(fread(buffer, 4, count, fp) != count){
+			return 0;
+		}
+		for(i = 0; i < count; i++){
+			widths[i] = read_le(buffer + 4*i, 4);
+		}
+		widths += count;
+		length -= count;
+	}
+
+	return 1;
+}
+
+int snapshot_save(SNAPSHOT *snapshot, const char *file_name){
+	uint8_t header[SNAPSHOT_HEADER_SIZE];
+	uint32_t tape_length;
+	FILE *fp;
+	int success;
+
+	tape_length = snapshot->tape->length;
+	memset(header, 0, sizeof(header));
+	memcpy(header + MAGIC, snapshot_magic, sizeof(snapshot_magic));
+	write_le(header + VERSION, SNAPSHOT_VERSION, 4);
+	write_le(header + MEMORY_OFFSET, SNAPSHOT_HEADER_SIZE, 4);
+	write_le(header + TAPE_LENGTH, tape_length, 4);
+	header[A_REG] = snapshot->cpu.A_reg;
+	header[X_REG] = snapshot->cpu.X_reg;
+	header[Y_REG] = snapshot->cpu.Y_reg;
+	header[SP_REG] = snapshot->cpu.SP_reg;
+	header[P_REG] = get_status_6502(&snapshot->cpu);
+	header[HALTED] = snapshot->cpu.halted;
+	write_le(header + PC_REG, snapshot->cpu.PC_reg, 2);
+	write_le(header + CYCLES, snapshot->cpu.cycles, 8);
+	header[KEY_DATA] = snapshot->key_data;
+	header[KEY_READY] = snapshot->key_ready;
+	write_le(header + DISPLAY_READY_CYCLES, snapshot->display_ready_cycles, 8);
+	header[TAPE_ACTIVE] = snapshot->tape_active;
+	header[TAPE_WRITING] = snapshot->tape_writing;
+	header[TAPE_READING] = snapshot->tape_reading;
+	header[TAPE_VALUE] = snapshot->tape_value;
+	write_le(header + TAPE_INDEX, snapshot->tape_index, 4);
+	write_le(header + TAPE_NEXT_EDGE, snapshot->tape_next_edge, 8);
+	write_le(header + TAPE_LAST_CYCLES, snapshot->tape_last_cycles, 8);
+	header[BASIC_ROM] = snapshot->basic_rom;
+
+	fp = fopen(file_name, "wb");
+	if(!fp){
+		return 0;
+	}
+	success = fwrite(header, 1, SNAPSHOT_HEADER_SIZE, fp) == SNAPSHOT_HEADER_SIZE &&
+		fwrite(snapshot->memory, 1, 0x10000, fp) == 0x10000 &&
+		write_widths(fp, snapshot->tape->widths, tape_length);
+	if(fclose(fp)){
+		success = 0;
+	}
+
+	return success;
+}
+
+int snapshot_load(SNAPSHOT *snapshot, const char *file_name){
+	uint8_t *memory;
+	uint8_t header[SNAPSHOT_HEADER_SIZE];
+	uint32_t memory_offset;
+	uint32_t tape_length;
+	long tape_offset;
+	long file_size;
+	TAPE tape;
+	FILE *fp;
+	int success;
+
+	fp = fopen(file_name, "rb");
+	if(!fp){
+		return 0;
+	}
+	if(fread(header, 1, SNAPSHOT_HEADER_SIZE, fp) != SNAPSHOT_HEADER_SIZE || memcmp(header + MAGIC, snapshot_magic, sizeof(snapshot_magic)) || read_le(header + VERSION, 4) != SNAPSHOT_VERSION){
+		fclose(fp);
+		return 0;
+	}
+	memory_offset = read_le(header + MEMORY_OFFSET, 4);
+	tape_length = read_le(header + TAPE_LENGTH, 4);
+
+	//Memory, registers and the tape are left alone unless the whole file reads
+	memory = malloc(0x10000);
+	if(!memory || fseek(fp, memory_offset, SEEK_SET) || fread(memory, 1, 0x10000, fp) != 0x10000){
+		free(memory);
+		fclose(fp);
+		return 0;
+	}
+
+	//Every width takes four bytes, so a length longer than the rest of the file is corrupt
+	tape_init(&tape);
+	success = (tape_offset = ftell(fp)) >= 0 && !fseek(fp, 0, SEEK_END) && (file_size = ftell(fp)) >= 0 && !fseek(fp, tape_offset, SEEK_SET) &&
+		tape_length <= (unsigned long) (file_size - tape_offset)/4 &&
+		(!tape_length || (tape_slot(&tape, tape_length - 1) && read_widths(fp, tape.widths, tape_length)));
+	fclose(fp);
+	if(!success){
+		free(tape.widths);
+		free(memory);
+		return 0;
+	}
+
+	memcpy(snapshot->memory, memory, 0x10000);
+	free(memory);
+	free(snapshot->tape->widths);
+	*snapshot->tape = tape;
+	snapshot->cpu.A_reg = header[A_REG];
+	snapshot->cpu.X_reg = header[X_REG];
+	snapshot->cpu.Y_reg = header[Y_REG];
+	snapshot->cpu.SP_reg = header[SP_REG];
+	set_status_6502(&snapshot->cpu, header[P_REG]);
+	snapshot->cpu.halted = header[HALTED];
+	snapshot->cpu.PC_reg = read_le(header + PC_REG, 2);
+	snapshot->cpu.cycles = read_le(header + CYCLES, 8);
+	snapshot->key_data = header[KEY_DATA];
+	snapshot->key_ready = header[KEY_READY];
+	snapshot->display_ready_cycles = read_le(header + DISPLAY_READY_CYCLES, 8);
+	snapshot->tape_active = header[TAPE_ACTIVE];
+	snapshot->tape_writing = header[TAPE_WRITING];
+	snapshot->tape_reading = header[TAPE_READING];
+	snapshot->tape_value = header[TAPE_VALUE];
+	snapshot->tape_index = read_le(header + TAPE_INDEX, 4);
+	snapshot->tape_next_edge = read_le(header + TAPE_NEXT_EDGE, 8);
+	snapshot->tape_last_cycles = read_le(header + TAPE_LAST_CYCLES, 8);
+	snapshot->basic_rom = header[BASIC_ROM];
+
+	return 1;
+}
@@ -0,0 +1,54 @@
+/*
+ * Machine snapshots
+ *
+ * A snapshot file holds everything needed to carry on running the
+ * machine where it left off: a header with the registers and device
+ * state, the 64 KB of memory starting on the first page boundary after
+ * the header, and then the widths of the loaded tape as 32-bit numbers.
+ * Numbers throughout are little endian.
+ */
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdint.h>
+#include "cpu.h"
+#include "tape.h"
+
+#define SNAPSHOT_VERSION 1
+
+//The header takes one page so memory can be mapped straight from the file
+#define SNAPSHOT_HEADER_SIZE 4096
+
+typedef struct SNAPSHOT SNAPSHOT;
+
+//The state saved, gathered from wherever it lives in the emulator
+struct SNAPSHOT{
+	CPU_6502 cpu;
+	uint8_t *memory;
+	//Keyboard register
+	uint8_t key_data;
+	uint8_t key_ready;
+	//When the display next accepts a character
+	unsigned long long int display_ready_cycles;
+	//Cassette deck
+	TAPE *tape;
+	unsigned char tape_active;
+	unsigned char tape_writing;
+	unsigned char tape_reading;
+	unsigned char tape_value;
+	uint32_t tape_index;
+	unsigned long long int tape_next_edge;
+	unsigned long long int tape_last_cycles;
+	//Whether BASIC is mapped as ROM, which older snapshots leave as 0
+	unsigned char basic_rom;
+};
+
+//Returns 0 if the file couldn't be written
+int snapshot_save(SNAPSHOT *snapshot, const char *file_name);
+
+//Fills in the snapshot, reading memory into the buffer it points to and replacing the tape it points to
+//Returns 0 if the file couldn't be read or isn't a snapshot
+int snapshot_load(SNAPSHOT *snapshot, const char *file_name);
+
+#endif
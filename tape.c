@@ -0,0 +1,468 @@
+/*
+ * Cassette tape
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+#include "tape.h"
+
+static const char tape_magic[6] = {'A', '1', 'T', 'A', 'P', 'E'};
+
+#define TAPE_HEADER_SIZE 15
+
+void tape_init(TAPE *tape){
+	tape->widths = NULL;
+	tape->length = 0;
+	tape->capacity = 0;
+}
+
+void tape_clear(TAPE *tape){
+	tape->length = 0;
+}
+
+static int tape_reserve(TAPE *tape, uint32_t capacity){
+	uint32_t new_capacity;
+	uint32_t *new_widths;
+
+	if(capacity <= tape->capacity){
+		return 1;
+	}
+	if(capacity > TAPE_MAX_LENGTH){
+		return 0;
+	}
+	new_capacity = tape->capacity ? tape->capacity : 1024;
+	while(new_capacity < capacity){
+		new_capacity *= 2;
+	}
+	if(new_capacity > TAPE_MAX_LENGTH){
+		new_capacity = TAPE_MAX_LENGTH;
+	}
+	new_widths = realloc(tape->widths, sizeof(uint32_t)*new_capacity);
+	if(!new_widths){
+		return 0;
+	}
+	tape->widths = new_widths;
+	tape->capacity = new_capacity;
+
+	return 1;
+}
+
+uint32_t *tape_slot(TAPE *tape, uint32_t index){
+	//Past the longest recording, where index + 1 could also wrap
+	if(index >= TAPE_MAX_LENGTH){
+		return NULL;
+	}
+	if(index >= tape->length){
+		if(!tape_reserve(tape, index + 1)){
+			return NULL;
+		}
+		memset(tape->widths + tape->length, 0, sizeof(uint32_t)*(index + 1 - tape->length));
+		tape->length = index + 1;
+	}
+
+	return tape->widths + index;
+}
+
+uint32_t tape_decode(TAPE *tape, uint32_t *index, uint8_t *buffer, uint32_t size, uint32_t clock_rate){
+	uint64_t sync_width;
+	uint64_t bit_width;
+	uint32_t i;
+	uint32_t count;
+	uint8_t value;
+	int bit;
+
+	sync_width = (uint64_t) TAPE_SYNC_WIDTH*clock_rate/1000000;
+	bit_width = (uint64_t) TAPE_BIT_WIDTH*clock_rate/1000000;
+
+	//Skip the header up to the start bit, then both halves of the start bit
+	i = *index;
+	while(i < tape->length && tape->widths[i] >= sync_width){
+		i++;
+	}
+	i += 2;
+
+	count = 0;
+	while(count < size && i + 16 <= tape->length){
+		value = 0;
+		for(bit = 0; bit < 8; bit++){
+			value = value<<1 | ((uint64_t) tape->widths[i] + tape->widths[i + 1] > bit_width);
+			i += 2;
+		}
+		buffer[count] = value;
+		count++;
+	}
+
+	if(i > tape->length){
+		i = tape->length;
+	}
+	*index = i;
+
+	return count;
+}
+
+static void write_le32(uint8_t *buffer, uint32_t value){
+	buffer[0] = value;
+	buffer[1] = value>>8;
+	buffer[2] = value>>16;
+	buffer[3] = value>>24;
+}
+
+static uint32_t read_le32(const uint8_t *buffer){
+	return buffer[0] | buffer[1]<<8 | buffer[2]<<16 | (uint32_t) buffer[3]<<24;
+}
+
+static uint16_t read_le16(const uint8_t *buffer){
+	return buffer[0] | buffer[1]<<8;
+}
+
+static void write_le16(uint8_t *buffer, uint16_t value){
+	buffer[0] = value;
+	buffer[1] = value>>8;
+}
+
+static int has_wav_extension(const char *file_name){
+	size_t length;
+	const char *extension = ".wav";
+	int i;
+
+	length = strlen(file_name);
+	if(length < 4){
+		return 0;
+	}
+	for(i = 0; i < 4; i++){
+		if(tolower((unsigned char) file_name[length - 4 + i]) != extension[i]){
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+//Turn the first channel of the samples into pulse widths as they stream past
+static int tape_load_wav_data(TAPE *tape, FILE *fp, uint32_t data_length, unsigned int channels, unsigned int bits, uint32_t sample_rate, uint32_t clock_rate){
+	uint8_t chunk[TAPE_CHUNK_SIZE];
+	size_t frame_size;
+	size_t chunk_size;
+	size_t i;
+	uint64_t sample_index;
+	uint64_t edge_cycles;
+	uint64_t last_edge_cycles;
+	uint32_t *width;
+	int sample;
+	int level;
+
+	frame_size = channels*bits/8;
+	sample_index = 0;
+	last_edge_cycles = 0;
+	//Unknown until the signal first leaves the dead band around zero
+	level = -1;
+
+	while(data_length >= frame_size){
+		chunk_size = TAPE_CHUNK_SIZE - TAPE_CHUNK_SIZE%frame_size;
+		if(chunk_size > data_length){
+			chunk_size = data_length - data_length%frame_size;
+		}
+		chunk_size = fread(chunk, 1, chunk_size, fp);
+		chunk_size -= chunk_size%frame_size;
+		if(!chunk_size){
+			break;
+		}
+		data_length -= chunk_size;
+
+		for(i = 0; i < chunk_size; i += frame_size){
+			if(bits == 8){
+				sample = (chunk[i] - 128)*256;
+			} else {
+				sample = (int16_t) read_le16(chunk + i);
+			}
+
+			if((sample > TAPE_WAV_HYSTERESIS && level != 1) || (sample < -TAPE_WAV_HYSTERESIS && level != 0)){
+				edge_cycles = sample_index*clock_rate/sample_rate;
+				//Any silence before the signal starts is left out of the first width
+				if(level >= 0){
+					width = tape_slot(tape, tape->length);
+					if(!width){
+						return 0;
+					}
+					*width = edge_cycles - last_edge_cycles;
+				}
+				last_edge_cycles = edge_cycles;
+				level = sample > 0;
+			}
+			sample_index++;
+		}
+	}
+
+	return !ferror(fp);
+}
+
+static int tape_load_wav(TAPE *tape, FILE *fp, uint32_t clock_rate){
+	uint8_t header[16];
+	uint32_t chunk_length;
+	uint32_t sample_rate = 0;
+	unsigned int channels = 0;
+	unsigned int bits = 0;
+
+	if(fread(header, 1, 12, fp) != 12){
+		return 0;
+	}
+
+	//Find the format, then stream the samples
+	while(fread(header, 1, 8, fp) == 8){
+		chunk_length = read_le32(header + 4);
+		if(!memcmp(header, "fmt ", 4)){
+			if(chunk_length < 16 || fread(header, 1, 16, fp) != 16){
+				return 0;
+			}
+			//Only uncompressed PCM
+			if(read_le16(header) != 1){
+				return 0;
+			}
+			channels = read_le16(header + 2);
+			sample_rate = read_le32(header + 4);
+			bits = read_le16(header + 14);
+			chunk_length -= 16;
+		} else if(!memcmp(header, "data", 4)){
+			//A frame has to fit in the chunk the samples are read through
+			if(!channels || !sample_rate || (bits != 8 && bits != 16) || channels*bits/8 > TAPE_CHUNK_SIZE){
+				return 0;
+			}
+			return tape_load_wav_data(tape, fp, chunk_length, channels, bits, sample_rate, clock_rate);
+		}
+		//Chunks are padded to an even length
+		if(fseek(fp, chunk_length + (chunk_length&1), SEEK_CUR)){
+			return 0;
+		}
+	}
+
+	return 0;
+}
+
+//Add a byte to the chunk being written, writing the chunk out once it fills
+static int put_byte(FILE *fp, uint8_t *chunk, size_t *chunk_size, uint8_t value){
+	if(*chunk_size == TAPE_CHUNK_SIZE){
+		if(fwrite(chunk, 1, TAPE_CHUNK_SIZE, fp) != TAPE_CHUNK_SIZE){
+			return 0;
+		}
+		*chunk_size = 0;
+	}
+	chunk[*chunk_size] = value;
+	(*chunk_size)++;
+
+	return 1;
+}
+
+static int tape_store_wav(TAPE *tape, FILE *fp, uint32_t clock_rate){
+	uint8_t chunk[TAPE_CHUNK_SIZE];
+	size_t chunk_size;
+	uint64_t total_cycles;
+	uint64_t edge_cycles;
+	uint64_t sample_index;
+	uint64_t end_sample;
+	uint32_t num_samples;
+	uint32_t i;
+	uint8_t value;
+
+	total_cycles = 0;
+	for(i = 0; i < tape->length; i++){
+		total_cycles += tape->widths[i];
+	}
+	//Hold the last level for a moment so the final edge can be found again
+	num_samples = total_cycles*TAPE_WAV_RATE/clock_rate + TAPE_WAV_RATE/1000;
+
+	//8-bit mono PCM
+	memcpy(chunk, "RIFF", 4);
+	write_le32(chunk + 4, 36 + num_samples + (num_samples&1));
+	memcpy(chunk + 8, "WAVEfmt ", 8);
+	write_le32(chunk + 16, 16);
+	write_le16(chunk + 20, 1);
+	write_le16(chunk + 22, 1);
+	write_le32(chunk + 24, TAPE_WAV_RATE);
+	write_le32(chunk + 28, TAPE_WAV_RATE);
+	write_le16(chunk + 32, 1);
+	write_le16(chunk + 34, 8);
+	memcpy(chunk + 36, "data", 4);
+	write_le32(chunk + 40, num_samples);
+	chunk_size = 44;
+
+	//The level starts low and changes at the end of every width
+	edge_cycles = 0;
+	sample_index = 0;
+	for(i = 0; i <= tape->length; i++){
+		if(i < tape->length){
+			edge_cycles += tape->widths[i];
+			end_sample = edge_cycles*TAPE_WAV_RATE/clock_rate;
+		} else {
+			end_sample = num_samples;
+		}
+		value = i&1 ? 128 + TAPE_WAV_AMPLITUDE : 128 - TAPE_WAV_AMPLITUDE;
+		while(sample_index < end_sample){
+			if(!put_byte(fp, chunk, &chunk_size, value)){
+				return 0;
+			}
+			sample_index++;
+		}
+	}
+
+	if((num_samples&1) && !put_byte(fp, chunk, &chunk_size, 0)){
+		return 0;
+	}
+
+	return fwrite(chunk, 1, chunk_size, fp) == chunk_size;
+}
+
+//The old format is every width as a native 32-bit integer
+static int tape_load_raw(TAPE *tape, FILE *fp){
+	uint32_t chunk[TAPE_CHUNK_SIZE/4];
+	size_t count;
+	size_t i;
+
+	while((count = fread(chunk, 4, TAPE_CHUNK_SIZE/4, fp)) > 0){
+		if(!tape_reserve(tape, tape->length + count)){
+			return 0;
+		}
+		for(i = 0; i < count; i++){
+			tape->widths[tape->length] = chunk[i];
+			tape->length++;
+		}
+	}
+
+	//Old files were always padded out to 4 MB with zeros
+	while(tape->length && !tape->widths[tape->length - 1]){
+		tape->length--;
+	}
+
+	return !ferror(fp);
+}
+
+static int tape_load_file(TAPE *tape, FILE *fp, uint32_t clock_rate){
+	uint8_t chunk[TAPE_CHUNK_SIZE];
+	size_t chunk_size;
+	size_t i;
+	long file_size;
+	uint32_t file_clock_rate;
+	uint32_t length;
+	uint32_t width;
+	unsigned int shift;
+
+	chunk_size = fread(chunk, 1, TAPE_HEADER_SIZE, fp);
+	if(chunk_size >= 12 && !memcmp(chunk, "RIFF", 4) && !memcmp(chunk + 8, "WAVE", 4)){
+		rewind(fp);
+		return tape_load_wav(tape, fp, clock_rate);
+	}
+	if(chunk_size < TAPE_HEADER_SIZE || memcmp(chunk, tape_magic, sizeof(tape_magic)) || chunk[6] != TAPE_VERSION){
+		rewind(fp);
+		return tape_load_raw(tape, fp);
+	}
+	file_clock_rate = read_le32(chunk + 7);
+	length = read_le32(chunk + 11);
+
+	//Every width takes at least a byte, so a corrupt length can't ask for more than the file holds
+	if(fseek(fp, 0, SEEK_END) || (file_size = ftell(fp)) < 0 || fseek(fp, TAPE_HEADER_SIZE, SEEK_SET)){
+		return 0;
+	}
+	if(!file_clock_rate || length > (unsigned long) file_size - TAPE_HEADER_SIZE || !tape_reserve(tape, length)){
+		return 0;
+	}
+
+	width = 0;
+	shift = 0;
+	while(tape->length < length && (chunk_size = fread(chunk, 1, TAPE_CHUNK_SIZE, fp)) > 0){
+		for(i = 0; i < chunk_size && tape->length < length; i++){
+			width |= (uint32_t) (chunk[i]&0x7F)<<shift;
+			shift += 7;
+			if(!(chunk[i]&0x80)){
+				if(file_clock_rate != clock_rate){
+					width = (uint64_t) width*clock_rate/file_clock_rate;
+				}
+				tape->widths[tape->length] = width;
+				tape->length++;
+				width = 0;
+				shift = 0;
+			} else if(shift >= 35){
+				return 0;
+			}
+		}
+	}
+
+	return !ferror(fp) && tape->length == length;
+}
+
+int tape_load(TAPE *tape, const char *file_name, uint32_t clock_rate){
+	FILE *fp;
+	TAPE loaded;
+	int success;
+
+	fp = fopen(file_name, "rb");
+	if(!fp){
+		return 0;
+	}
+	//The tape already loaded stays put unless the whole file can be read
+	tape_init(&loaded);
+	success = tape_load_file(&loaded, fp, clock_rate);
+	fclose(fp);
+	if(!success){
+		free(loaded.widths);
+		return 0;
+	}
+	free(tape->widths);
+	*tape = loaded;
+
+	return 1;
+}
+
+int tape_store(TAPE *tape, const char *file_name, uint32_t clock_rate){
+	FILE *fp;
+	uint8_t chunk[TAPE_CHUNK_SIZE];
+	size_t chunk_size;
+	uint32_t i;
+	uint32_t width;
+
+	fp = fopen(file_name, "wb");
+	if(!fp){
+		return 0;
+	}
+
+	if(has_wav_extension(file_name)){
+		if(!tape_store_wav(tape, fp, clock_rate)){
+			fclose(fp);
+			return 0;
+		}
+		return fclose(fp) == 0;
+	}
+
+	memcpy(chunk, tape_magic, sizeof(tape_magic));
+	chunk[6] = TAPE_VERSION;
+	write_le32(chunk + 7, clock_rate);
+	write_le32(chunk + 11, tape->length);
+	chunk_size = TAPE_HEADER_SIZE;
+
+	for(i = 0; i < tape->length; i++){
+		//A width takes at most five bytes
+		if(chunk_size > TAPE_CHUNK_SIZE - 5){
+			if(fwrite(chunk, 1, chunk_size, fp) != chunk_size){
+				fclose(fp);
+				return 0;
+			}
+			chunk_size = 0;
+		}
+		width = tape->widths[i];
+		while(width >= 0x80){
+			chunk[chunk_size] = (width&0x7F)|0x80;
+			chunk_size++;
+			width >>= 7;
+		}
+		chunk[chunk_size] = width;
+		chunk_size++;
+	}
+
+	if(fwrite(chunk, 1, chunk_size, fp) != chunk_size){
+		fclose(fp);
+		return 0;
+	}
+
+	return fclose(fp) == 0;
+}
@@ -0,0 +1,75 @@
+/*
+ * Cassette tape
+ *
+ * A recording is the list of pulse widths between level changes, in CPU
+ * cycles. Tape files hold only the widths that were recorded, as
+ * variable-length integers after a short header:
+ *
+ *     "A1TAPE" version(1) clock_rate(4) length(4) widths...
+ *
+ * Numbers in the header are little endian. Each width is stored seven
+ * bits at a time, low bits first, with the top bit set on every byte but
+ * the last. Files in the old format, a raw array of 32-bit widths, are
+ * still loaded.
+ *
+ * Recordings of real tapes can be loaded from 8 or 16-bit PCM WAV files,
+ * which are streamed through a zero crossing detector. Storing to a file
+ * name ending in .wav writes the recording out as a square wave.
+ */
+
+#ifndef TAPE_H
+#define TAPE_H
+
+#include <stdint.h>
+
+#define TAPE_VERSION 1
+
+//Half cycles of the tone shorter than this many microseconds mark the start bit after the header
+#define TAPE_SYNC_WIDTH 450
+
+//Full cycles longer than this many microseconds are ones, shorter ones are zeros
+#define TAPE_BIT_WIDTH 750
+
+//Samples must swing this far past zero, out of 32768, to count as a crossing
+#define TAPE_WAV_HYSTERESIS 1024
+
+//Format of the WAV files written
+#define TAPE_WAV_RATE 44100
+#define TAPE_WAV_AMPLITUDE 96
+
+//Most widths a recording holds, a couple of hours of tape at 1 MHz
+#define TAPE_MAX_LENGTH 0x2000000UL
+
+//Files are read and written this many bytes at a time
+#define TAPE_CHUNK_SIZE 4096
+
+typedef struct TAPE TAPE;
+
+struct TAPE{
+	uint32_t *widths;
+	uint32_t length;
+	uint32_t capacity;
+};
+
+void tape_init(TAPE *tape);
+
+//Forget the recording without giving up the memory
+void tape_clear(TAPE *tape);
+
+//Return the width at index, growing the recording to include it
+//Returns NULL if out of memory or index is past TAPE_MAX_LENGTH
+uint32_t *tape_slot(TAPE *tape, uint32_t index);
+
+//Decode a block written by the ACI starting from the width at *index, most significant bit first
+//Stores up to size bytes and leaves *index after the last pulse used
+//Returns the number of bytes decoded
+uint32_t tape_decode(TAPE *tape, uint32_t *index, uint8_t *buffer, uint32_t size, uint32_t clock_rate);
+
+//Replace the recording with the one in a file, scaling the widths to clock_rate
+//Returns 0, leaving the recording as it was, if the file couldn't be read
+int tape_load(TAPE *tape, const char *file_name, uint32_t clock_rate);
+
+//Returns 0 if the file couldn't be written
+int tape_store(TAPE *tape, const char *file_name, uint32_t clock_rate);
+
+#endif
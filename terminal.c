@@ -0,0 +1,19 @@
+/*
+ * Terminal interface
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include "terminal.h"
+
+TERMINAL *terminal = &curses_terminal;
+
+void term_printf(const char *format, ...){
+	char buffer[256];
+	va_list args;
+
+	va_start(args, format);
+	vsnprintf(buffer, sizeof(buffer), format, args);
+	va_end(args);
+	terminal->message(buffer);
+}
@@ -0,0 +1,50 @@
+/*
+ * Terminal interface
+ *
+ * The emulator talks to the user through one of these, either the
+ * ncurses screen or plain stdin/stdout for running without a terminal.
+ */
+
+#ifndef TERMINAL_H
+#define TERMINAL_H
+
+//Returned by get_key when no key is waiting
+#define NO_KEY (-1)
+//Returned by get_key and wait_key once the input has been used up
+#define END_OF_INPUT (-2)
+
+typedef struct TERMINAL TERMINAL;
+
+struct TERMINAL{
+	//Whether someone is sitting at the terminal who can answer prompts
+	unsigned char interactive;
+	void (*start)();
+	void (*stop)();
+	//Return the next key typed without waiting, or NO_KEY
+	int (*get_key)();
+	//Wait for the next key typed
+	int (*wait_key)();
+	//Wait up to timeout milliseconds for a key without taking it
+	void (*wait_input)(int timeout);
+	//Read a line for the debug prompt
+	//Returns 0 once the input has been used up and there's no line to read
+	int (*get_line)(char *buffer, int size);
+	//Output of the Apple 1's display
+	void (*display)(const char *text);
+	//Messages from the emulator itself
+	void (*message)(const char *text);
+	//Make everything output so far visible
+	void (*flush)();
+	void (*clear)();
+};
+
+extern TERMINAL *terminal;
+
+extern TERMINAL curses_terminal;
+
+extern TERMINAL headless_terminal;
+
+//printf a message to the terminal
+void term_printf(const char *format, ...);
+
+#endif
@@ -0,0 +1,98 @@
+/*
+ * ncurses terminal
+ */
+
+#include "terminal.h"
+
+#ifdef _WIN32
+
+#include <curses.h>
+
+#else
+
+#include <ncurses.h>
+
+#endif
+
+static void curses_start(){
+	initscr();
+	cbreak();
+	noecho();
+	scrollok(stdscr, 1);
+	nodelay(stdscr, 1);
+}
+
+static void curses_stop(){
+	printw("Press any key to exit...\n");
+	nodelay(stdscr, 0);
+	getch();
+
+	endwin();
+}
+
+static int curses_get_key(){
+	int key_hit;
+
+	key_hit = getch();
+	if(key_hit == ERR){
+		return NO_KEY;
+	}
+	return key_hit;
+}
+
+static int curses_wait_key(){
+	int key_hit;
+
+	nodelay(stdscr, 0);
+	key_hit = getch();
+	nodelay(stdscr, 1);
+
+	return key_hit;
+}
+
+static void curses_wait_input(int timeout){
+	int key_hit;
+
+	wtimeout(stdscr, timeout);
+	key_hit = getch();
+	nodelay(stdscr, 1);
+	if(key_hit != ERR){
+		ungetch(key_hit);
+	}
+}
+
+static int curses_get_line(char *buffer, int size){
+	nodelay(stdscr, 0);
+	echo();
+	getnstr(buffer, size - 1);
+	noecho();
+	nodelay(stdscr, 1);
+
+	return 1;
+}
+
+static void curses_display(const char *text){
+	printw("%s", text);
+}
+
+static void curses_flush(){
+	refresh();
+}
+
+static void curses_clear(){
+	clear();
+}
+
+TERMINAL curses_terminal = {
+	1,
+	curses_start,
+	curses_stop,
+	curses_get_key,
+	curses_wait_key,
+	curses_wait_input,
+	curses_get_line,
+	curses_display,
+	curses_display,
+	curses_flush,
+	curses_clear
+};
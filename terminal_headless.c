@@ -0,0 +1,137 @@
+/*
+ * Headless terminal
+ *
+ * Keys come from stdin without blocking the emulator, the Apple 1's
+ * display goes to stdout and the emulator's own messages go to stderr.
+ * This lets programs be piped in and output captured without a tty.
+ */
+
+#include <stdio.h>
+#include "terminal.h"
+
+#ifdef _WIN32
+
+#include <conio.h>
+#include <windows.h>
+
+#else
+
+#include <poll.h>
+#include <unistd.h>
+
+#endif
+
+static unsigned char input_ended;
+
+static void headless_start(){
+}
+
+static void headless_stop(){
+	fflush(stdout);
+}
+
+static int headless_wait_key(){
+	unsigned char c;
+
+	if(input_ended){
+		return END_OF_INPUT;
+	}
+#ifdef _WIN32
+	return _getch();
+#else
+	if(read(0, &c, 1) != 1){
+		input_ended = 1;
+		return END_OF_INPUT;
+	}
+	return c;
+#endif
+}
+
+static int headless_get_key(){
+#ifndef _WIN32
+	struct pollfd input;
+
+#endif
+	if(input_ended){
+		return END_OF_INPUT;
+	}
+#ifdef _WIN32
+	if(!_kbhit()){
+		return NO_KEY;
+	}
+#else
+	input.fd = 0;
+	input.events = POLLIN;
+	if(poll(&input, 1, 0) <= 0){
+		return NO_KEY;
+	}
+#endif
+	return headless_wait_key();
+}
+
+static void headless_wait_input(int timeout){
+#ifdef _WIN32
+	while(timeout > 0 && !_kbhit()){
+		Sleep(10);
+		timeout -= 10;
+	}
+#else
+	struct pollfd input;
+
+	if(input_ended){
+		return;
+	}
+	input.fd = 0;
+	input.events = POLLIN;
+	poll(&input, 1, timeout);
+#endif
+}
+
+static int headless_get_line(char *buffer, int size){
+	int i = 0;
+	int c = 0;
+	int got_line;
+
+	while(i < size - 1 && (c = headless_wait_key()) != END_OF_INPUT && c != '\n'){
+		buffer[i] = c;
+		i++;
+	}
+	//A last line without a newline is still read
+	got_line = i || c != END_OF_INPUT;
+	//Lines from Windows end in \r\n
+	if(i && buffer[i - 1] == '\r'){
+		i--;
+	}
+	buffer[i] = (char) 0;
+
+	return got_line;
+}
+
+static void headless_display(const char *text){
+	fputs(text, stdout);
+}
+
+static void headless_message(const char *text){
+	fputs(text, stderr);
+}
+
+static void headless_flush(){
+	fflush(stdout);
+}
+
+static void headless_clear(){
+}
+
+TERMINAL headless_terminal = {
+	0,
+	headless_start,
+	headless_stop,
+	headless_get_key,
+	headless_wait_key,
+	headless_wait_input,
+	headless_get_line,
+	headless_display,
+	headless_message,
+	headless_flush,
+	headless_clear
+};